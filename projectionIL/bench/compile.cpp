@@ -0,0 +1,221 @@
+#include <ast.h>
+#include <driver.h>
+#include <ssa.h>
+#include <whisk_action.h>
+
+#include "workloads.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/* Compile time benchmark over the synthetic workloads.
+ *
+ * Every workload is compiled in a child process of its own so that the
+ * peak RSS belongs to that compilation only. Each prints one JSON object
+ * per line with the time spent in every compiler phase.
+ *
+ * Usage: compile [--no-fold-results] [--no-compact-keys] [--manifest]
+ *                [--value-bytes N] [workload size]...
+ * Without workloads the default suite is run. --no-fold-results keeps a
+ * separate result projection after every fork, to compare against folding.
+ * --manifest times generateManifest instead of the shell script.
+ * The bytes the saved state GC removes from every edge are estimated with
+ * sample values of --value-bytes each (1024 by default). saved_keys counts
+ * the keys the saved_values of the program are stored under in .saved, one
+ * per value with --no-compact-keys, which saves them under their SSA names.
+ */
+
+typedef std::chrono::steady_clock Clock;
+
+struct BenchmarkRun
+{
+  WorkloadKind kind;
+  int size;
+};
+
+static const BenchmarkRun defaultSuite[] =
+{
+  {CallChainWorkload, 1000},
+  {CallChainWorkload, 10000},
+  {IfNestWorkload, 100},
+  {IfNestWorkload, 1000},
+  {SiblingBranchesWorkload, 1000},
+  {SiblingBranchesWorkload, 3000},
+  {NestedLoopsWorkload, 10},
+  {NestedLoopsWorkload, 100},
+  {PatternChainsWorkload, 100},
+  {PatternChainsWorkload, 1000},
+  {FanOutWorkload, 100},
+  {FanOutWorkload, 1000},
+};
+
+static bool foldResultProjections = true;
+static bool compactKeys = true;
+static bool manifest = false;
+static int valueBytes = 1024;
+
+static double elapsedMs (Clock::time_point& start)
+{
+  Clock::time_point now = Clock::now ();
+  double ms = std::chrono::duration<double, std::milli> (now - start).count ();
+
+  start = now;
+  return ms;
+}
+
+//generateCommand creates an empty file for every projection, remove the
+//ones named in the generated script.
+static void removeProjectionFiles (const std::string& script)
+{
+  const std::string prefix = "/tmp/wsk-proj-";
+  size_t pos = 0;
+
+  while ((pos = script.find (prefix, pos)) != std::string::npos) {
+    std::string file = script.substr (pos, prefix.size () + 6);
+    unlink (file.c_str ());
+    pos += prefix.size ();
+  }
+}
+
+static void runWorkload (WorkloadKind kind, int size)
+{
+  double ssaMs, optimizeMs, convertMs, fuseMs, generateMs;
+  size_t outputBytes, numberOfBlocks;
+  int statements, hopsRemoved;
+  SavedStateStats gcStats;
+  struct rusage usage;
+
+  {
+    CompilationArena arena;
+    ComplexCommand cmds;
+    Program* program;
+    std::vector<WhiskSequence*> seqs;
+    WhiskProgram* whiskProgram;
+    std::ostringstream script;
+
+    statements = buildWorkload (cmds, kind, size);
+
+    Clock::time_point start = Clock::now ();
+    program = convertToSSA (&cmds);
+    ssaMs = elapsedMs (start);
+    optimize (program, std::unordered_set<std::string> (), compactKeys);
+    optimizeMs = elapsedMs (start);
+    gcStats = savedStateStats (program);
+    start = Clock::now ();
+    whiskProgram = (WhiskProgram*)program->convert (program, seqs);
+    convertMs = elapsedMs (start);
+    hopsRemoved = whiskProgram->fuseProjections (foldResultProjections);
+    fuseMs = elapsedMs (start);
+    if (manifest) {
+      whiskProgram->generateManifest (script);
+    } else {
+      whiskProgram->generateCommand (script);
+    }
+    generateMs = elapsedMs (start);
+
+    numberOfBlocks = program->getBasicBlocks ().size ();
+    outputBytes = script.str ().size ();
+    removeProjectionFiles (script.str ());
+  }
+
+  getrusage (RUSAGE_SELF, &usage);
+
+  std::cout << "{\"workload\": \"" << workloadNames[kind] << "\""
+            << ", \"size\": " << size
+            << ", \"statements\": " << statements
+            << ", \"basic_blocks\": " << numberOfBlocks
+            << ", \"convertToSSA_ms\": " << ssaMs
+            << ", \"optimize_ms\": " << optimizeMs
+            << ", \"convert_ms\": " << convertMs
+            << ", \"fuseProjections_ms\": " << fuseMs
+            << ", \"output\": \"" << (manifest ? "manifest" : "script") << "\""
+            << ", \"generate_ms\": " << generateMs
+            << ", \"fold_results\": " << (foldResultProjections ? "true" : "false")
+            << ", \"hops_removed\": " << hopsRemoved
+            << ", \"gc_deletes\": " << gcStats.deletes
+            << ", \"gc_bytes_saved_per_edge\": "
+            << (double) (gcStats.savedValues - gcStats.liveValues) * valueBytes / std::max (gcStats.edges, 1)
+            << ", \"saved_values\": " << gcStats.values
+            << ", \"saved_keys\": " << gcStats.keys
+            << ", \"output_bytes\": " << outputBytes
+            << ", \"arena_peak_bytes\": " << CompilationArena::getLastPeakBytes ()
+            << ", \"peak_rss_kb\": " << usage.ru_maxrss
+            << "}" << std::endl;
+}
+
+static int findWorkload (const char* name)
+{
+  for (int i = 0; i < NumberOfWorkloads; i++) {
+    if (strcmp (workloadNames[i], name) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+int main (int argc, char** argv)
+{
+  std::vector<BenchmarkRun> runs;
+  int first = 1;
+
+  for (; first < argc && strncmp (argv[first], "--", 2) == 0; first++) {
+    if (strcmp (argv[first], "--no-fold-results") == 0) {
+      foldResultProjections = false;
+    } else if (strcmp (argv[first], "--no-compact-keys") == 0) {
+      compactKeys = false;
+    } else if (strcmp (argv[first], "--manifest") == 0) {
+      manifest = true;
+    } else if (strcmp (argv[first], "--value-bytes") == 0 && first + 1 < argc) {
+      valueBytes = atoi (argv[++first]);
+    } else {
+      std::cerr << "compile: unknown option '" << argv[first] << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  if (argc == first) {
+    runs.assign (defaultSuite, defaultSuite + sizeof (defaultSuite)/sizeof (defaultSuite[0]));
+  } else {
+    for (int i = first; i + 1 < argc; i += 2) {
+      int kind = findWorkload (argv[i]);
+
+      if (kind == -1) {
+        std::cerr << "compile: unknown workload '" << argv[i] << "'" << std::endl;
+        return 1;
+      }
+
+      runs.push_back (BenchmarkRun {(WorkloadKind)kind, atoi (argv[i + 1])});
+    }
+  }
+
+  for (auto run : runs) {
+    pid_t pid;
+    int status;
+
+    std::cout.flush ();
+    pid = fork ();
+    if (pid == 0) {
+      runWorkload (run.kind, run.size);
+      std::cout.flush ();
+      _exit (0);
+    }
+
+    if (pid == -1 || waitpid (pid, &status, 0) == -1 || !WIFEXITED (status) ||
+        WEXITSTATUS (status) != 0) {
+      std::cerr << "compile: " << workloadNames[run.kind] << " " << run.size
+                << " failed" << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,163 @@
+#include <ast.h>
+#include <driver.h>
+#include <ssa.h>
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+/* Compares kind tag dispatch against the dynamic_cast ladders it replaced.
+ *
+ * Builds a straight line program of N statements (calls, pattern
+ * assignments and a conditional every few statements), converts it to SSA
+ * and then classifies every instruction of the program many times, once
+ * through a chain of dynamic_casts in the order the passes used to test
+ * them and once through a switch over getKind ().
+ *
+ * Only the dispatch is timed, not the passes: the old passes are gone, so
+ * this measures what a node visit saves, not a whole compilation.
+ *
+ * Usage: dispatch [statements] [rounds]
+ */
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedMs (Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli> (Clock::now () - start).count ();
+}
+
+static void buildProgram (ComplexCommand& cmds, int statements)
+{
+  JSONInput* input = arenaNew<JSONInput> ();
+  JSONIdentifier* prev = arenaNew<JSONIdentifier> ("X0");
+
+  cmds (arenaNew<CallAction> (prev, "A0", input));
+  for (int i = 1; i < statements; i++) {
+    std::stringstream id;
+    JSONIdentifier* next;
+
+    id << "X" << i;
+    next = arenaNew<JSONIdentifier> (id.str ());
+
+    if (i % 10 == 0) {
+      IfThenElseCommand* ifThen;
+
+      ifThen = arenaNew<IfThenElseCommand> (&((*prev)["flag"] == 1));
+      ifThen->getThenBranch () (arenaNew<CallAction> (next, "A1", prev));
+      ifThen->getElseBranch () (arenaNew<CallAction> (next, "A2", prev));
+      cmds (ifThen);
+    } else if (i % 3 == 0) {
+      cmds (arenaNew<JSONAssignment> (next, &(*prev)["x"]["y"]));
+    } else {
+      cmds (arenaNew<CallAction> (next, "A1", prev));
+    }
+
+    prev = next;
+  }
+
+  cmds (arenaNew<ReturnJSON> (prev));
+}
+
+static int classifyDynamicCast (Instruction* instr)
+{
+  if (dynamic_cast <Call*> (instr) != nullptr)
+    return 0;
+  else if (dynamic_cast <Assignment*> (instr) != nullptr)
+    return 1;
+  else if (dynamic_cast <ConditionalBranch*> (instr) != nullptr)
+    return 2;
+  else if (dynamic_cast <Return*> (instr) != nullptr)
+    return 3;
+  else if (dynamic_cast <PHI*> (instr) != nullptr)
+    return 4;
+  else if (dynamic_cast <BackwardBranch*> (instr) != nullptr)
+    return 5;
+  else if (dynamic_cast <DirectBranch*> (instr) != nullptr)
+    return 6;
+
+  return 7;
+}
+
+static int classifyKind (Instruction* instr)
+{
+  switch (instr->getKind ()) {
+  case IRNode::CallKind:
+    return 0;
+  case IRNode::AssignmentKind:
+    return 1;
+  case IRNode::ConditionalBranchKind:
+    return 2;
+  case IRNode::ReturnKind:
+    return 3;
+  case IRNode::PHIKind:
+    return 4;
+  case IRNode::BackwardBranchKind:
+    return 5;
+  case IRNode::DirectBranchKind:
+    return 6;
+  default:
+    return 7;
+  }
+}
+
+template <typename Classifier>
+static double timeDispatch (std::vector<Instruction*>& instrs, int rounds,
+                            Classifier classify, long& checksum)
+{
+  Clock::time_point start = Clock::now ();
+
+  checksum = 0;
+  for (int r = 0; r < rounds; r++) {
+    for (auto instr : instrs) {
+      checksum += classify (instr);
+    }
+  }
+
+  return elapsedMs (start);
+}
+
+int main (int argc, char** argv)
+{
+  int statements = argc > 1 ? atoi (argv[1]) : 10000;
+  int rounds = argc > 2 ? atoi (argv[2]) : 200;
+
+  CompilationArena arena;
+  ComplexCommand cmds;
+  Program* program;
+  std::vector<Instruction*> instrs;
+  long dynamicCastSum, kindSum;
+  double ssaMs, dynamicCastMs, kindMs;
+
+  buildProgram (cmds, statements);
+
+  Clock::time_point start = Clock::now ();
+  program = convertToSSA (&cmds);
+  ssaMs = elapsedMs (start);
+
+  for (auto bb : program->getBasicBlocks ()) {
+    for (auto instr : bb->getInstructions ()) {
+      instrs.push_back (instr);
+    }
+  }
+
+  dynamicCastMs = timeDispatch (instrs, rounds, classifyDynamicCast, dynamicCastSum);
+  kindMs = timeDispatch (instrs, rounds, classifyKind, kindSum);
+
+  if (dynamicCastSum != kindSum) {
+    std::cerr << "dispatch: classifications differ" << std::endl;
+    return 1;
+  }
+
+  std::cout << "statements " << statements << std::endl;
+  std::cout << "instructions " << instrs.size () << std::endl;
+  std::cout << "convertToSSA_ms " << ssaMs << std::endl;
+  std::cout << "dynamic_cast_ms " << dynamicCastMs << std::endl;
+  std::cout << "kind_switch_ms " << kindMs << std::endl;
+  std::cout << "speedup " << dynamicCastMs / kindMs << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,176 @@
+#include <ast.h>
+
+#include <string>
+
+#ifndef __WORKLOADS_H__
+#define __WORKLOADS_H__
+
+/* Generators for synthetic SPL programs of a given shape and size.
+ *
+ * All nodes are allocated with arenaNew, so the generators have to run
+ * inside a CompilationArena. Each returns the number of simple commands it
+ * added to cmds.
+ */
+
+enum WorkloadKind
+{
+  CallChainWorkload,
+  IfNestWorkload,
+  SiblingBranchesWorkload,
+  NestedLoopsWorkload,
+  PatternChainsWorkload,
+  FanOutWorkload,
+  NumberOfWorkloads
+};
+
+static const char* workloadNames[] =
+{
+  "chain",
+  "ifnest",
+  "branches",
+  "loops",
+  "patterns",
+  "fanout"
+};
+
+static std::string actionName (int i)
+{
+  return "A" + std::to_string (i);
+}
+
+//X = A0 (input); X = A1 (X); ... X = An-1 (X); return X
+static int buildCallChain (ComplexCommand& cmds, int n)
+{
+  JSONIdentifier* x = arenaNew<JSONIdentifier> ("X");
+
+  cmds (arenaNew<CallAction> (x, actionName (0), arenaNew<JSONInput> ()));
+  for (int i = 1; i < n; i++) {
+    cmds (arenaNew<CallAction> (x, actionName (i), x));
+  }
+  cmds (arenaNew<ReturnJSON> (x));
+
+  return n + 1;
+}
+
+//if (X["flag"] == 0) then {X = A (X); if (X["flag"] == 1) then {...}
+//else X = B (X)} else X = B (X), depth ifs deep. Every join needs a PHI.
+static int buildIfNest (ComplexCommand& cmds, int depth)
+{
+  JSONIdentifier* x = arenaNew<JSONIdentifier> ("X");
+  ComplexCommand* current = &cmds;
+  int statements = 2;
+
+  cmds (arenaNew<CallAction> (x, actionName (0), arenaNew<JSONInput> ()));
+  for (int i = 0; i < depth; i++) {
+    IfThenElseCommand* ifThen;
+
+    ifThen = arenaNew<IfThenElseCommand> (&((*x)["flag"] == i));
+    ifThen->getThenBranch () (arenaNew<CallAction> (x, actionName (2*i + 1), x));
+    ifThen->getElseBranch () (arenaNew<CallAction> (x, actionName (2*i + 2), x));
+    (*current) (ifThen);
+    current = &ifThen->getThenBranch ();
+    statements += 3;
+  }
+  cmds (arenaNew<ReturnJSON> (x));
+
+  return statements;
+}
+
+//width conditionals one after the other, each redefining X in both branches.
+static int buildSiblingBranches (ComplexCommand& cmds, int width)
+{
+  JSONIdentifier* x = arenaNew<JSONIdentifier> ("X");
+
+  cmds (arenaNew<CallAction> (x, actionName (0), arenaNew<JSONInput> ()));
+  for (int i = 0; i < width; i++) {
+    IfThenElseCommand* ifThen;
+
+    ifThen = arenaNew<IfThenElseCommand> (&((*x)["flag"] == i));
+    ifThen->getThenBranch () (arenaNew<CallAction> (x, actionName (2*i + 1), x));
+    ifThen->getElseBranch () (arenaNew<CallAction> (x, actionName (2*i + 2), x));
+    cmds (ifThen);
+  }
+  cmds (arenaNew<ReturnJSON> (x));
+
+  return 3*width + 2;
+}
+
+//while (X < 10) {X = A (X); while (X < 10) {...}}, depth loops deep.
+static int buildNestedLoops (ComplexCommand& cmds, int depth)
+{
+  JSONIdentifier* x = arenaNew<JSONIdentifier> ("X");
+  ComplexCommand* current = &cmds;
+
+  cmds (arenaNew<CallAction> (x, actionName (0), arenaNew<JSONInput> ()));
+  for (int i = 0; i < depth; i++) {
+    WhileLoop* loop;
+
+    loop = arenaNew<WhileLoop> (&((*x) < 10));
+    loop->getBody () (arenaNew<CallAction> (x, actionName (i + 1), x));
+    (*current) (loop);
+    current = &loop->getBody ();
+  }
+  cmds (arenaNew<ReturnJSON> (x));
+
+  return 2*depth + 2;
+}
+
+//X = A0 (input); Yi = X["key_i"]["value"]["data"]; Zi = Ai (Yi) for width
+//keys, so that only the used keys of X need to be saved.
+static int buildPatternChains (ComplexCommand& cmds, int width)
+{
+  JSONIdentifier* x = arenaNew<JSONIdentifier> ("X");
+
+  cmds (arenaNew<CallAction> (x, actionName (0), arenaNew<JSONInput> ()));
+  for (int i = 0; i < width; i++) {
+    JSONIdentifier* y = arenaNew<JSONIdentifier> ("Y" + std::to_string (i));
+    JSONIdentifier* z = arenaNew<JSONIdentifier> ("Z" + std::to_string (i));
+
+    cmds (arenaNew<JSONAssignment> (y, &(*x)["key_" + std::to_string (i)]["value"]["data"]));
+    cmds (arenaNew<CallAction> (z, actionName (i + 1), y));
+  }
+  cmds (arenaNew<ReturnJSON> (x));
+
+  return 2*width + 2;
+}
+
+//X = A0 (input); Yi = Ai (X["key_i"]) for width independent lookups;
+//return X.
+static int buildFanOut (ComplexCommand& cmds, int width)
+{
+  JSONIdentifier* x = arenaNew<JSONIdentifier> ("X");
+
+  cmds (arenaNew<CallAction> (x, actionName (0), arenaNew<JSONInput> ()));
+  for (int i = 0; i < width; i++) {
+    JSONIdentifier* key = arenaNew<JSONIdentifier> ("K" + std::to_string (i));
+    JSONIdentifier* y = arenaNew<JSONIdentifier> ("Y" + std::to_string (i));
+
+    cmds (arenaNew<JSONAssignment> (key, &(*x)["key_" + std::to_string (i)]));
+    cmds (arenaNew<CallAction> (y, actionName (i + 1), key));
+  }
+  cmds (arenaNew<ReturnJSON> (x));
+
+  return 2*width + 2;
+}
+
+static int buildWorkload (ComplexCommand& cmds, WorkloadKind kind, int size)
+{
+  switch (kind) {
+    case CallChainWorkload:
+      return buildCallChain (cmds, size);
+    case IfNestWorkload:
+      return buildIfNest (cmds, size);
+    case SiblingBranchesWorkload:
+      return buildSiblingBranches (cmds, size);
+    case NestedLoopsWorkload:
+      return buildNestedLoops (cmds, size);
+    case PatternChainsWorkload:
+      return buildPatternChains (cmds, size);
+    case FanOutWorkload:
+      return buildFanOut (cmds, size);
+    default:
+      abort ();
+  }
+}
+
+#endif /*__WORKLOADS_H__*/
@@ -0,0 +1,74 @@
+#include <ast.h>
+#include <iostream>
+
+//Loops whose PHIs read values of the previous iteration. INC adds 1 to its
+//input, run each program on {"i": 0, "a": 1, "b": 2, "x": 5}.
+int main ()
+{
+  //Swap loop, returns 2
+  {
+    CompilationArena arena;
+    ComplexCommand cmds;
+    JSONInput input;
+    JSONIdentifier I ("I"), A ("A"), B ("B"), T ("T");
+    Action INC ("INC");
+    cmds (arenaNew<JSONAssignment> (&I, &input["i"]));
+    cmds (arenaNew<JSONAssignment> (&A, &input["a"]));
+    cmds (arenaNew<JSONAssignment> (&B, &input["b"]));
+    WhileLoop loop (&(I < 3));
+    loop.getBody () (arenaNew<JSONAssignment> (&T, &A));
+    loop.getBody () (arenaNew<JSONAssignment> (&A, &B));
+    loop.getBody () (arenaNew<JSONAssignment> (&B, &T));
+    loop.getBody () (INC (&I, &I));
+    cmds (&loop);
+    ReturnJSON r (&A);
+    cmds (&r);
+    convertToWhiskCommands (cmds, std::cout, true);
+    std::cout << std::endl;
+  }
+
+  //y = x; x = INC (x), returns 7
+  {
+    CompilationArena arena;
+    ComplexCommand cmds;
+    JSONInput input;
+    JSONIdentifier I ("I"), X ("X"), Y ("Y");
+    Action INC ("INC");
+    cmds (arenaNew<JSONAssignment> (&I, &input["i"]));
+    cmds (arenaNew<JSONAssignment> (&X, &input["x"]));
+    cmds (arenaNew<JSONAssignment> (&Y, &X));
+    WhileLoop loop (&(I < 3));
+    loop.getBody () (arenaNew<JSONAssignment> (&Y, &X));
+    loop.getBody () (INC (&X, &X));
+    loop.getBody () (INC (&I, &I));
+    cmds (&loop);
+    ReturnJSON r (&Y);
+    cmds (&r);
+    convertToWhiskCommands (cmds, std::cout, true);
+    std::cout << std::endl;
+  }
+
+  //t = a; a = INC (b); b = t, returns 4
+  {
+    CompilationArena arena;
+    ComplexCommand cmds;
+    JSONInput input;
+    JSONIdentifier I ("I"), A ("A"), B ("B"), T ("T");
+    Action INC ("INC");
+    cmds (arenaNew<JSONAssignment> (&I, &input["i"]));
+    cmds (arenaNew<JSONAssignment> (&A, &input["a"]));
+    cmds (arenaNew<JSONAssignment> (&B, &input["b"]));
+    WhileLoop loop (&(I < 3));
+    loop.getBody () (arenaNew<JSONAssignment> (&T, &A));
+    loop.getBody () (INC (&A, &B));
+    loop.getBody () (arenaNew<JSONAssignment> (&B, &T));
+    loop.getBody () (INC (&I, &I));
+    cmds (&loop);
+    ReturnJSON r (&A);
+    cmds (&r);
+    convertToWhiskCommands (cmds, std::cout, true);
+    std::cout << std::endl;
+  }
+
+  return 0;
+}
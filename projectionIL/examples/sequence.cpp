@@ -5,6 +5,7 @@ int main ()
 {
   //Sequence of 10
   {
+    CompilationArena arena;
     ComplexCommand cmds;
     JSONInput input;
     JSONIdentifier X1 ("X1");
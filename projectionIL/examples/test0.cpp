@@ -5,6 +5,7 @@ int main ()
 {
 //test0  
   {
+    CompilationArena arena;
     ComplexCommand cmds;
     JSONInput input;
     JSONIdentifier X1("X1"), X2("X2"), X3("X3"), X4("X4"), X5("X5");
@@ -12,12 +13,12 @@ int main ()
     cmds (A1 (&X1, &input));
     //auto pq = X1[0]["x"];
     //auto qq = pq;
-    cmds (new JSONAssignment (&X2, &X1["x"]["y"]["z"][0]));
-    cmds (new JSONAssignment (&X3, &X1["x"]["y"][0]["c"]));
+    cmds (arenaNew<JSONAssignment> (&X2, &X1["x"]["y"]["z"][0]));
+    cmds (arenaNew<JSONAssignment> (&X3, &X1["x"]["y"][0]["c"]));
     cmds (A1 (&X2, &X2));
-    cmds (new JSONAssignment (&X5, &X2["X2_a"]["X2_b"]["X2_c"]));
+    cmds (arenaNew<JSONAssignment> (&X5, &X2["X2_a"]["X2_b"]["X2_c"]));
     IfThenElseCommand ifthen (&(X5 == X3));
-    WhileLoop loop (&(X1 < 10), new CallAction (&X1, "A2", &X1));
+    WhileLoop loop (&(X1 < 10), arenaNew<CallAction> (&X1, "A2", &X1));
     cmds (&ifthen);
     //~ ifthen.thenStart ()
     ifthen.getThenBranch() (A2 (&X3, &X5));
@@ -0,0 +1,178 @@
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+/* Compilation scoped region allocator.
+ *
+ * Every AST, SSA and backend node of one compilation is carved out of a
+ * few large chunks instead of being a separate heap allocation. Objects of
+ * the same type are packed together in typed pools so that passes walking
+ * over Identifiers or Instructions touch contiguous memory. Nothing is freed
+ * individually, the whole region (including the destructors of the nodes)
+ * goes away in one step when the arena is released.
+ */
+
+enum
+{
+  ARENA_CHUNK_SIZE = 64*1024,
+  ARENA_POOL_SLAB_OBJECTS = 64
+};
+
+class Arena
+{
+private:
+  struct Chunk
+  {
+    char* start;
+    size_t size;
+  };
+
+  struct Pool
+  {
+    char* next;
+    char* end;
+  };
+
+  struct Destructor
+  {
+    void* object;
+    void (*destroy) (void*);
+  };
+
+  std::vector<Chunk> chunks;
+  std::vector<Pool> pools;
+  std::vector<Destructor> destructors;
+  char* next;
+  char* end;
+  size_t bytesAllocated;
+  size_t bytesReserved;
+  size_t peakBytes;
+
+  static Arena* currentArena;
+  static size_t numberOfPoolTypes;
+
+  char* allocateChunk (size_t size);
+  //Carves size bytes out of the current chunk without counting them, the
+  //callers count the bytes they hand out.
+  char* allocateFromChunk (size_t size, size_t align);
+  void* allocateFromPool (size_t poolIndex, size_t size, size_t align);
+  void countBytes (size_t size);
+
+  //Each type gets a dense pool index the first time it is allocated.
+  template <typename T>
+  static size_t poolIndex ()
+  {
+    static size_t index = numberOfPoolTypes++;
+    return index;
+  }
+
+  template <typename T>
+  static void destroy (void* object)
+  {
+    static_cast<T*> (object)->~T ();
+  }
+
+public:
+  Arena ();
+  ~Arena ();
+
+  Arena (const Arena&) = delete;
+  Arena& operator= (const Arena&) = delete;
+
+  void* allocate (size_t size, size_t align = alignof (std::max_align_t));
+
+  template <typename T, typename... Args>
+  T* create (Args&&... args)
+  {
+    void* mem = allocateFromPool (poolIndex<T> (), sizeof (T), alignof (T));
+    T* object = new (mem) T (std::forward<Args> (args)...);
+
+    if (!std::is_trivially_destructible<T>::value) {
+      destructors.push_back (Destructor {object, &destroy<T>});
+    }
+
+    return object;
+  }
+
+  //Destroys all objects in reverse order of creation and returns the
+  //chunks to the system.
+  void release ();
+
+  //Bytes of the objects created and of the blocks allocated, without the
+  //unused rest of pool slabs and chunks, which getBytesReserved counts.
+  size_t getBytesAllocated () const {return bytesAllocated;}
+  size_t getBytesReserved () const {return bytesReserved;}
+  size_t getPeakBytes () const {return peakBytes;}
+
+  static Arena* current () {return currentArena;}
+  static void setCurrent (Arena* arena) {currentArena = arena;}
+};
+
+/* Makes a fresh Arena the current one for its lifetime. All nodes created
+ * through arenaNew while it is alive are owned by it and are freed when it
+ * goes out of scope. Scopes nest, the previous arena is restored on exit.
+ */
+class CompilationArena
+{
+private:
+  Arena arena;
+  Arena* previous;
+  CompilationArena* outer;
+  //Peak of the bytes of this arena and the ones nested in it together.
+  size_t nestedPeakBytes;
+  static CompilationArena* currentCompilation;
+  static size_t lastPeakBytes;
+
+public:
+  CompilationArena () : previous (Arena::current ()), outer (currentCompilation), nestedPeakBytes (0)
+  {
+    Arena::setCurrent (&arena);
+    currentCompilation = this;
+  }
+
+  ~CompilationArena ()
+  {
+    //Nothing is allocated in the outer arena while this one is current,
+    //so its bytes now are its bytes all along.
+    if (outer != nullptr && outer->arena.getBytesAllocated () + getPeakBytes () > outer->nestedPeakBytes)
+      outer->nestedPeakBytes = outer->arena.getBytesAllocated () + getPeakBytes ();
+    lastPeakBytes = getPeakBytes ();
+    currentCompilation = outer;
+    Arena::setCurrent (previous);
+    arena.release ();
+  }
+
+  Arena& getArena () {return arena;}
+
+  //Peak number of bytes of the objects of this arena and the arenas nested
+  //in it.
+  size_t getPeakBytes () const
+  {
+    return arena.getPeakBytes () > nestedPeakBytes ? arena.getPeakBytes () : nestedPeakBytes;
+  }
+
+  //Peak number of bytes of the objects of the most recently finished
+  //compilation, including its nested arenas.
+  static size_t getLastPeakBytes () {return lastPeakBytes;}
+};
+
+//Allocates in the current arena, or on the heap when no compilation is
+//active so that code outside of a CompilationArena keeps working.
+template <typename T, typename... Args>
+T* arenaNew (Args&&... args)
+{
+  Arena* arena = Arena::current ();
+
+  if (arena != nullptr) {
+    return arena->create<T> (std::forward<Args> (args)...);
+  }
+
+  return new T (std::forward<Args> (args)...);
+}
+
+#endif /*__ARENA_H__*/
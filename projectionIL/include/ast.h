@@ -7,6 +7,8 @@
 
 #include <assert.h>
 
+#include "arena.h"
+#include "casting.h"
 //#include "utils.h"
 
 #ifndef __AST_H__
@@ -66,13 +68,11 @@
  * return X3
 */
 
-//TODO: JSONExpression in CallAction, While Condition are JSONIdentifier.
-//Make them more general so they can take any expression as input.
-
 typedef std::string ActionName;
 
 class JSONPatternApplication;
 class CallAction;
+class JSONExpression;
 class JSONIdentifier;
 class JSONAssignment;
 class JSONConditional;
@@ -99,9 +99,52 @@ class ASTVisitor
 
 class ASTNode
 {
+public:
+  //Concrete node kinds. Kinds of a class hierarchy are contiguous so that
+  //classof of an abstract class is a range check.
+  enum NodeKind
+  {
+    ActionKind,
+    JSONIdentifierKind,
+    JSONInputKind,
+    JSONConditionalKind,
+    NumberExpressionKind,
+    StringExpressionKind,
+    BooleanExpressionKind,
+    JSONArrayExpressionKind,
+    JSONObjectExpressionKind,
+    JSONPatternApplicationKind,
+    ComplexCommandKind,
+    ReturnJSONKind,
+    CallActionKind,
+    JSONAssignmentKind,
+    LetCommandKind,
+    IfThenElseCommandKind,
+    WhileLoopKind,
+    KeyValuePairKind,
+    FieldGetJSONPatternKind,
+    ArrayIndexJSONPatternKind,
+    KeyGetJSONPatternKind,
+    
+    FirstJSONExpressionKind = JSONIdentifierKind,
+    LastJSONExpressionKind = JSONPatternApplicationKind,
+    FirstConstantExpressionKind = NumberExpressionKind,
+    LastConstantExpressionKind = BooleanExpressionKind,
+    FirstCommandKind = ComplexCommandKind,
+    LastCommandKind = WhileLoopKind,
+    FirstSimpleCommandKind = ReturnJSONKind,
+    LastSimpleCommandKind = WhileLoopKind,
+    FirstJSONPatternKind = FieldGetJSONPatternKind,
+    LastJSONPatternKind = KeyGetJSONPatternKind
+  };
+  
+private:
+  const NodeKind kind;
+  
 protected:
-  ASTNode () {}
+  ASTNode (NodeKind _kind) : kind(_kind) {}
 public:
+  NodeKind getKind () const {return kind;}
   virtual void print (std::ostream& os) = 0;
   virtual ~ASTNode () {}
 };
@@ -112,16 +155,27 @@ protected:
   std::string name;
   
 public:
-  Action (std::string _name) : name (_name) {}
+  Action (std::string _name) : ASTNode (ActionKind), name (_name) {}
+  
+  static bool classof (const ASTNode* node) {return node->getKind () == ActionKind;}
   
   std::string getName () {return name;}
-  CallAction* operator () (JSONIdentifier* out, JSONIdentifier* in);
+  CallAction* operator () (JSONIdentifier* out, JSONExpression* in);
   virtual void print (std::ostream& os) {fprintf (stderr, "Action::print should never be called\n"); abort ();}
 };
 
 class JSONExpression : public ASTNode
 {
+protected:
+  JSONExpression (NodeKind _kind) : ASTNode (_kind) {}
+  
 public:
+  static bool classof (const ASTNode* node)
+  {
+    return node->getKind () >= FirstJSONExpressionKind && 
+           node->getKind () <= LastJSONExpressionKind;
+  }
+  
   virtual JSONPatternApplication& operator [] (std::string key);
   virtual JSONPatternApplication& operator [] (const char* key);
   virtual JSONPatternApplication& operator [] (int index);
@@ -156,16 +210,28 @@ private:
   
 public:
   JSONIdentifier (std::string id, CallAction* _callStmt) : 
-    identifier(id)
+    JSONExpression (JSONIdentifierKind), identifier(id)
   {
     callStmt = _callStmt;
   }
   
-  JSONIdentifier (std::string id) : identifier(id)
+  JSONIdentifier (std::string id) : JSONExpression (JSONIdentifierKind), identifier(id)
+  {
+    callStmt = nullptr;
+  }
+  
+protected:
+  JSONIdentifier (std::string id, NodeKind _kind) : JSONExpression (_kind), identifier(id)
   {
     callStmt = nullptr;
   }
   
+public:
+  static bool classof (const ASTNode* node)
+  {
+    return node->getKind () == JSONIdentifierKind || node->getKind () == JSONInputKind;
+  }
+  
   void setCallStmt(CallAction* _callStmt);
   std::string getIdentifier () {return identifier;}
   CallAction* getCallStmt () {return callStmt;}
@@ -188,18 +254,30 @@ public:
     ReturnCommandType
   } type;
 protected:
-  Command(CommandType _type) : type(_type) {}
-  Command(Command& c) : type(c.type) {}
+  Command(CommandType _type, NodeKind _kind) : ASTNode (_kind), type(_type) {}
+  Command(Command& c) : ASTNode (c.getKind ()), type(c.type) {}
 public:
   CommandType getType() {return type;}
+  
+  static bool classof (const ASTNode* node)
+  {
+    return node->getKind () >= FirstCommandKind && node->getKind () <= LastCommandKind;
+  }
+
   virtual ~Command () {}
 };
 
 class SimpleCommand : public Command
 {
 public:
-  SimpleCommand (): Command(SimpleCommandType) {}
+  SimpleCommand (NodeKind _kind): Command(SimpleCommandType, _kind) {}
   virtual ~SimpleCommand () {}
+  
+  static bool classof (const ASTNode* node)
+  {
+    return node->getKind () >= FirstSimpleCommandKind && 
+           node->getKind () <= LastSimpleCommandKind;
+  }
 };
 
 class ComplexCommand : public Command
@@ -209,13 +287,15 @@ protected:
   std::string actionName;
     
 public:
-  ComplexCommand(std::vector<SimpleCommand*> _cmds): Command (ComplexCommandType), 
+  ComplexCommand(std::vector<SimpleCommand*> _cmds): Command (ComplexCommandType, ComplexCommandKind), 
                                                     cmds(_cmds)
   {}
   
-  ComplexCommand(): Command (ComplexCommandType)
+  ComplexCommand(): Command (ComplexCommandType, ComplexCommandKind)
   {}
   
+  static bool classof (const ASTNode* node) {return node->getKind () == ComplexCommandKind;}
+  
   void operator () (SimpleCommand* cmd)
   {
     appendSimpleCommand (cmd);
@@ -247,11 +327,13 @@ private:
   JSONExpression* exp;
   
 public:
-  ReturnJSON (JSONExpression* _exp) : SimpleCommand ()
+  ReturnJSON (JSONExpression* _exp) : SimpleCommand (ReturnJSONKind)
   {
     exp = _exp;
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == ReturnJSONKind;}
+  
   JSONExpression* getReturnExpr() {return exp;}
   
   virtual void print (std::ostream& os)
@@ -276,12 +358,14 @@ protected:
   
 public:
   CallAction(JSONIdentifier* _retVal, ActionName _actionName, JSONExpression* _arg) : 
-    SimpleCommand(), retVal(_retVal), actionName (_actionName), arg(_arg) 
+    SimpleCommand(CallActionKind), retVal(_retVal), actionName (_actionName), arg(_arg) 
   {
     //retVal->setCallStmt(this);
     callID++;
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == CallActionKind;}
+  
   JSONIdentifier* getReturnValue() {return retVal;}
   virtual std::string getActionName() {return actionName;}
   JSONExpression* getArgument() {return arg;}
@@ -333,9 +417,11 @@ private:
   
 public:
   JSONConditional (JSONExpression* _op1, ConditionalOperator _op, JSONExpression* _op2) :
-    op (_op), op1(_op1), op2(_op2)
+    JSONExpression (JSONConditionalKind), op (_op), op1(_op1), op2(_op2)
   {}
   
+  static bool classof (const ASTNode* node) {return node->getKind () == JSONConditionalKind;}
+  
   JSONExpression* getOp1 () {return op1;}
   JSONExpression* getOp2 () {return op2;}
   ConditionalOperator getOperator () {return op;}
@@ -388,10 +474,12 @@ private:
   
 public:
   JSONAssignment (JSONIdentifier* _out, JSONExpression* _in) : 
-    out(_out), in(_in)
+    SimpleCommand (JSONAssignmentKind), out(_out), in(_in)
   {
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == JSONAssignmentKind;}
+  
   JSONIdentifier* getOutput() {return out;}
   JSONExpression* getInput() {return in;}
   
@@ -410,8 +498,11 @@ private:
   JSONIdentifier* id;
 
 public:
-  LetCommand (JSONIdentifier* _id, JSONExpression* _expr) : id(_id), expr(_expr) 
+  LetCommand (JSONIdentifier* _id, JSONExpression* _expr) : 
+    SimpleCommand (LetCommandKind), expr(_expr), id(_id)
   {}
+  
+  static bool classof (const ASTNode* node) {return node->getKind () == LetCommandKind;}
 };
 
 class IfThenElseCommand : public SimpleCommand
@@ -422,15 +513,15 @@ private:
   ComplexCommand* elseBranch;
   
 public:
-  IfThenElseCommand (JSONConditional* _expr) 
+  IfThenElseCommand (JSONConditional* _expr) : SimpleCommand (IfThenElseCommandKind)
   {
     expr = _expr;
-    thenBranch = new ComplexCommand ();
-    elseBranch = new ComplexCommand ();
+    thenBranch = arenaNew<ComplexCommand> ();
+    elseBranch = arenaNew<ComplexCommand> ();
   }
   
   IfThenElseCommand (JSONConditional* _expr, ComplexCommand* _thenBranch, 
-                     ComplexCommand* _elseBranch)
+                     ComplexCommand* _elseBranch) : SimpleCommand (IfThenElseCommandKind)
   {
     expr = _expr;
     thenBranch = _thenBranch;
@@ -438,15 +529,17 @@ public:
   }
   
   IfThenElseCommand (JSONConditional* _expr, SimpleCommand* _thenBranch, 
-                     SimpleCommand* _elseBranch)
+                     SimpleCommand* _elseBranch) : SimpleCommand (IfThenElseCommandKind)
   {
     expr = _expr;
-    thenBranch = new ComplexCommand ();
+    thenBranch = arenaNew<ComplexCommand> ();
     thenBranch->appendSimpleCommand (_thenBranch);
-    elseBranch = new ComplexCommand ();
+    elseBranch = arenaNew<ComplexCommand> ();
     elseBranch->appendSimpleCommand (_elseBranch);
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == IfThenElseCommandKind;}
+  
   ComplexCommand& getThenBranch () 
   {
     return *thenBranch;
@@ -490,20 +583,24 @@ private:
   JSONConditional* cond;
   
 public:
-  WhileLoop (JSONConditional* _cond)
+  WhileLoop (JSONConditional* _cond) : SimpleCommand (WhileLoopKind), cond(_cond)
   {
-    cmds = new ComplexCommand ();
+    cmds = arenaNew<ComplexCommand> ();
   }
   
-  WhileLoop (JSONConditional* _cond, ComplexCommand* _cmds) : cond(_cond), cmds(_cmds)
+  WhileLoop (JSONConditional* _cond, ComplexCommand* _cmds) : 
+    SimpleCommand (WhileLoopKind), cmds(_cmds), cond(_cond)
   {}
   
-  WhileLoop (JSONConditional* _cond, SimpleCommand* _cmd) : cond(_cond)
+  WhileLoop (JSONConditional* _cond, SimpleCommand* _cmd) : 
+    SimpleCommand (WhileLoopKind), cond(_cond)
   {
-    cmds = new ComplexCommand ();
+    cmds = arenaNew<ComplexCommand> ();
     cmds->appendSimpleCommand (_cmd);
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == WhileLoopKind;}
+  
   JSONConditional* getCondition ()
   {
     return cond;
@@ -524,6 +621,15 @@ public:
 
 class ConstantExpression : public JSONExpression
 {
+protected:
+  ConstantExpression (NodeKind _kind) : JSONExpression (_kind) {}
+  
+public:
+  static bool classof (const ASTNode* node)
+  {
+    return node->getKind () >= FirstConstantExpressionKind && 
+           node->getKind () <= LastConstantExpressionKind;
+  }
 };
 
 class NumberExpression : public ConstantExpression
@@ -532,10 +638,12 @@ private:
   float number;
   
 public:
-  NumberExpression (float _number) : number(_number)
+  NumberExpression (float _number) : ConstantExpression (NumberExpressionKind), number(_number)
   {
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == NumberExpressionKind;}
+  
   float getNumber ()
   {
     return number;
@@ -553,9 +661,11 @@ private:
   std::string str;
   
 public:
-  StringExpression (std::string _str) : str(_str) 
+  StringExpression (std::string _str) : ConstantExpression (StringExpressionKind), str(_str) 
   {
   }
+  
+  static bool classof (const ASTNode* node) {return node->getKind () == StringExpressionKind;}
 
   std::string getString () 
   {
@@ -574,10 +684,12 @@ private:
   bool boolean;
   
 public:
-  BooleanExpression (bool _boolean) : boolean(_boolean) 
+  BooleanExpression (bool _boolean) : ConstantExpression (BooleanExpressionKind), boolean(_boolean) 
   {
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == BooleanExpressionKind;}
+  
   void print (std::ostream& os)
   {
     if (boolean)
@@ -598,9 +710,12 @@ private:
   std::vector<JSONExpression*> exprs;
   
 public:
-  JSONArrayExpression (std::vector<JSONExpression*> _exprs): exprs(_exprs) 
+  JSONArrayExpression (std::vector<JSONExpression*> _exprs): 
+    JSONExpression (JSONArrayExpressionKind), exprs(_exprs) 
   {
   }
+  
+  static bool classof (const ASTNode* node) {return node->getKind () == JSONArrayExpressionKind;}
 };
 
 class KeyValuePair : public ASTNode
@@ -610,10 +725,13 @@ private:
   JSONExpression* value;
   
 public:
-  KeyValuePair (std::string _key, JSONExpression* _value) : key(_key), value(_value)
+  KeyValuePair (std::string _key, JSONExpression* _value) : 
+    ASTNode (KeyValuePairKind), key(_key), value(_value)
   {
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == KeyValuePairKind;}
+  
   std::string getKey () {return key;}
   JSONExpression* getValue () {return value;}
 };
@@ -624,10 +742,13 @@ private:
   std::vector<KeyValuePair*> kvpairs;
   
 public:
-  JSONObjectExpression (std::vector<KeyValuePair*> _kvpairs) : kvpairs(_kvpairs) 
+  JSONObjectExpression (std::vector<KeyValuePair*> _kvpairs) : 
+    JSONExpression (JSONObjectExpressionKind), kvpairs(_kvpairs) 
   {
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == JSONObjectExpressionKind;}
+  
   std::vector<KeyValuePair*>& getKVPairs ()
   {
     return kvpairs;
@@ -637,12 +758,21 @@ public:
 class JSONInput : public JSONIdentifier 
 {
 public:
-  JSONInput () : JSONIdentifier ("input") {}
+  JSONInput () : JSONIdentifier ("input", JSONInputKind) {}
+  
+  static bool classof (const ASTNode* node) {return node->getKind () == JSONInputKind;}
 };
 
 class JSONPattern : public ASTNode
 {
+protected:
+  JSONPattern (NodeKind _kind) : ASTNode (_kind) {}
+  
 public:
+  static bool classof (const ASTNode* node)
+  {
+    return node->getKind () >= FirstJSONPatternKind && node->getKind () <= LastJSONPatternKind;
+  }
 };
 
 class JSONPatternApplication : public JSONExpression
@@ -652,10 +782,13 @@ private:
   JSONPattern* pat;
   
 public:
-  JSONPatternApplication (JSONExpression* _expr, JSONPattern* _pat): expr(_expr), pat(_pat)
+  JSONPatternApplication (JSONExpression* _expr, JSONPattern* _pat): 
+    JSONExpression (JSONPatternApplicationKind), expr(_expr), pat(_pat)
   {
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == JSONPatternApplicationKind;}
+  
   JSONPattern* getPattern () {return pat;}
   JSONExpression* getExpression () {return expr;}
   
@@ -672,10 +805,13 @@ private:
   std::string fieldName;
   
 public:
-  FieldGetJSONPattern (std::string _fieldName) : fieldName(_fieldName) 
+  FieldGetJSONPattern (std::string _fieldName) : 
+    JSONPattern (FieldGetJSONPatternKind), fieldName(_fieldName) 
   {
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == FieldGetJSONPatternKind;}
+  
   std::string getFieldName ()
   {
     return fieldName;
@@ -693,10 +829,12 @@ private:
   int index;
   
 public:
-  ArrayIndexJSONPattern (int _index) : index(_index) 
+  ArrayIndexJSONPattern (int _index) : JSONPattern (ArrayIndexJSONPatternKind), index(_index) 
   {
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == ArrayIndexJSONPatternKind;}
+  
   int getIndex ()
   {
     return index;
@@ -714,10 +852,12 @@ private:
   std::string keyName;
   
 public:
-  KeyGetJSONPattern (std::string _keyName) : keyName(_keyName) 
+  KeyGetJSONPattern (std::string _keyName) : JSONPattern (KeyGetJSONPatternKind), keyName(_keyName) 
   {
   }
   
+  static bool classof (const ASTNode* node) {return node->getKind () == KeyGetJSONPatternKind;}
+  
   std::string getKeyName ()
   {
     return keyName;
@@ -729,6 +869,37 @@ public:
   }
 };
 
+struct CompilerOptions
+{
+  bool optimize;
+  bool printSSA;
+  //Save the result of a call in the projection following its fork instead
+  //of a separate projection after every fork. Needs optimize.
+  bool foldResultProjections;
+  //Actions without side effects, whose result depends on their argument
+  //only. Calls to one of them with the same argument run once. Needs
+  //optimize.
+  std::unordered_set<std::string> pureActions;
+  //Save values under short keys, s0, s1, ..., instead of their SSA names,
+  //values whose live ranges do not overlap sharing a key. Needs optimize.
+  bool compactKeys;
+  //With optimize and compactKeys, a file to which a JSON object mapping
+  //every key to the SSA values saved under it is written, for debugging.
+  std::string keyTable;
+  //Write a JSONL deployment manifest (see whisk_action.h) instead of a
+  //shell script of wsk commands.
+  bool manifest;
+  //Deployment state files, see whisk_action.h. With previousState only the
+  //actions changed since that deployment are written, followed by the
+  //orphaned ones. The state of this deployment is written to newState.
+  std::string previousState;
+  std::string newState;
+  
+  CompilerOptions () : optimize(true), printSSA(false), foldResultProjections(true), compactKeys(true),
+    manifest(false) {}
+};
+
+void convertToWhiskCommands (ComplexCommand& cmds, std::ostream& out, const CompilerOptions& options);
 void convertToWhiskCommands (ComplexCommand& cmds, std::ostream& out, bool to_optimize, bool print_ssa = false);
 //TODO: Add complex pattern
 #endif /*__AST_H__*/
@@ -0,0 +1,34 @@
+#include <assert.h>
+
+#ifndef __CASTING_H__
+#define __CASTING_H__
+
+/* Kind based type tests for the AST and SSA class hierarchies.
+ *
+ * Every node carries a kind tag and every class provides a static
+ * classof (node) which checks it, so these replace dynamic_cast with a
+ * compare (or a range check for abstract classes) and no RTTI walk.
+ */
+
+template <typename To, typename From>
+inline bool isa (const From* node)
+{
+  return To::classof (node);
+}
+
+//Cast which must succeed.
+template <typename To, typename From>
+inline To* cast (From* node)
+{
+  assert (isa<To> (node));
+  return static_cast<To*> (node);
+}
+
+//Returns nullptr if node is not a To.
+template <typename To, typename From>
+inline To* dyn_cast (From* node)
+{
+  return isa<To> (node) ? static_cast<To*> (node) : nullptr;
+}
+
+#endif /*__CASTING_H__*/
@@ -1,27 +1,89 @@
 #include <string>
 #include <vector>
 #include <string.h>
+#include <stdlib.h>
 #include "utils.h"
+#include "arena.h"
+#include "casting.h"
 
 #ifndef __SERVERLESS_H__
 #define __SERVERLESS_H__
 
+enum
+{
+  WHISK_FORK_NAME_LENGTH = 10,
+  WHISK_SEQ_NAME_LENGTH = 10,
+  WHISK_PROJ_NAME_LENGTH = 10
+};
+
+//Hashes str so that consecutive fields cannot run into each other.
+inline uint64_t hashField (const std::string& str, uint64_t hash)
+{
+  return fnvHash (str, fnvHash (std::to_string (str.size ()) + ":", hash));
+}
+
 class ServerlessAction
 {
+public:
+  //Backend action kinds, tested with isa<> like the AST and SSA nodes.
+  enum ActionKind
+  {
+    SequenceKind,
+    ProjectionKind,
+    BranchProjectionKind,
+    ForkKind,
+    ProjForkPairKind,
+    AppKind,
+    DirectBranchKind,
+    IfKind,
+    ProgramKind,
+    
+    FirstProjectionKind = ProjectionKind,
+    LastProjectionKind = BranchProjectionKind,
+    FirstAppKind = AppKind,
+    LastAppKind = DirectBranchKind
+  };
+  
 private:
   std::string name;
+  const ActionKind kind;
+  
+protected:
+  //Actions created without a name are named from their content the first
+  //time the name is needed, after every action they refer to exists.
+  virtual std::string computeName () {abort ();}
   
 public:
-  ServerlessAction(std::string _name) : name(_name)
+  ServerlessAction(ActionKind _kind) : kind(_kind)
+  {
+  }
+  
+  ServerlessAction(std::string _name, ActionKind _kind) : name(_name), kind(_kind)
   {
   }
   
   virtual ~ServerlessAction () {}
   
-  const char* getName () {return name.c_str ();}
+  ActionKind getKind () const {return kind;}
+  
+  const char* getName ()
+  {
+    if (name.empty ())
+      name = computeName ();
+    
+    return name.c_str ();
+  }
+  
+  //Hash of the content of the action, in which basic blocks are represented
+  //by their position in the program instead of their name. Basic blocks are
+  //named from it, so it must not need their names.
+  virtual uint64_t hashStructure (uint64_t hash) {return fnvHash (getName (), hash);}
   
   virtual void print () = 0;
   virtual void generateCommand(std::ostream& os) = 0;
+  //Writes the deployment manifest entries of the action, one JSON object
+  //per line. Backends without a manifest leave it empty.
+  virtual void generateManifest (std::ostream& os) {}
   virtual std::string getNameForSeq () {return getName ();}
 };
 
@@ -31,14 +93,20 @@ protected:
   std::vector<ServerlessAction*> actions;
   
 public:
-  ServerlessSequence(std::string name) : ServerlessAction (name)
+  ServerlessSequence() : ServerlessAction (SequenceKind)
   {
   }
   
-  ServerlessSequence(std::string name, std::vector<ServerlessAction*> _actions) : ServerlessAction(name), actions(_actions)
+  ServerlessSequence(std::string name) : ServerlessAction (name, SequenceKind)
   {
   }
   
+  ServerlessSequence(std::string name, std::vector<ServerlessAction*> _actions) : ServerlessAction(name, SequenceKind), actions(_actions)
+  {
+  }
+  
+  static bool classof (const ServerlessAction* action) {return action->getKind () == SequenceKind;}
+  
   std::vector<ServerlessAction*>& getActions () {return actions;}
   void appendAction (ServerlessAction* action) {actions.push_back (action);}
   void insertAction (ServerlessAction* action, int index) {actions.insert (actions.begin()+index, action);}
@@ -49,16 +117,36 @@ class ServerlessProjection : public ServerlessAction
 protected:
   std::string projCode;
   
+  ServerlessProjection (ActionKind kind) : ServerlessAction (kind)
+  {
+  }
+  
+  virtual std::string computeName ()
+  {
+    return "Proj_" + gen_hash_str (getProjCode (), WHISK_PROJ_NAME_LENGTH);
+  }
+  
 public:
-  ServerlessProjection (std::string name, std::string _code) : ServerlessAction (name), projCode (_code)
+  ServerlessProjection (std::string _code) : ServerlessAction (ProjectionKind), projCode (_code)
+  {
+  }
+  
+  ServerlessProjection (std::string name, std::string _code) : ServerlessAction (name, ProjectionKind), projCode (_code)
+  {
+  }
+  
+  static bool classof (const ServerlessAction* action)
   {
+    return action->getKind () >= FirstProjectionKind && action->getKind () <= LastProjectionKind;
   }
   
-  std::string getProjCode () {return projCode;}
+  virtual std::string getProjCode () {return projCode;}
+  
+  virtual uint64_t hashStructure (uint64_t hash) {return fnvHash (getProjCode (), hash);}
   
   virtual void print ()
   {
-    fprintf (stdout, "(WhiskProjection: '%s', %s)", getName (), projCode.c_str ());
+    fprintf (stdout, "(WhiskProjection: '%s', %s)", getName (), getProjCode ().c_str ());
   }
 };
 
@@ -71,18 +159,26 @@ protected:
   std::string returnName;
   std::string requiredFields;
   
+  //Forks of the same action are the same action.
+  virtual std::string computeName ()
+  {
+    return "Fork_" + innerActionName + "_" + gen_hash_str (innerActionName, WHISK_FORK_NAME_LENGTH);
+  }
+  
 public:
-  ServerlessFork (std::string name, std::string _innerActionName, std::string _returnName, std::string _requiredFields) : 
-    ServerlessAction(name), innerActionName(_innerActionName), returnName(_returnName), requiredFields(_requiredFields)
+  ServerlessFork (std::string _innerActionName, std::string _returnName, std::string _requiredFields) : 
+    ServerlessAction(ForkKind), innerActionName(_innerActionName), returnName(_returnName), requiredFields(_requiredFields)
   {
   }
   
-  ServerlessFork (std::string name, ServerlessAction* _innerAction, std::string _returnName, std::string _requiredFields) : 
-    ServerlessAction(name), innerAction(_innerAction), returnName (_returnName), requiredFields(_requiredFields)
+  ServerlessFork (ServerlessAction* _innerAction, std::string _returnName, std::string _requiredFields) : 
+    ServerlessAction(ForkKind), innerAction(_innerAction), returnName (_returnName), requiredFields(_requiredFields)
   {
     innerActionName = innerAction->getName ();
   }
   
+  static bool classof (const ServerlessAction* action) {return action->getKind () == ForkKind;}
+  
   std::string getInnerActionName()
   {
     return innerActionName;
@@ -105,9 +201,17 @@ class ServerlessApp : public ServerlessAction
 {
 private:
 public:
-  ServerlessApp () : ServerlessAction("App")
+  ServerlessApp () : ServerlessAction("App", AppKind)
   {}
   
+  ServerlessApp (ActionKind kind) : ServerlessAction("App", kind)
+  {}
+  
+  static bool classof (const ServerlessAction* action)
+  {
+    return action->getKind () >= FirstAppKind && action->getKind () <= LastAppKind;
+  }
+  
   virtual void print ()
   {
     fprintf (stdout, "App");
@@ -125,12 +229,17 @@ protected:
   std::vector <ServerlessSequence*> basicBlocks;
 
 public:
-  ServerlessProgram (std::string _name) : ServerlessAction(_name)
+  ServerlessProgram (std::string _name) : ServerlessAction(_name, ProgramKind)
   {}
   
-  ServerlessProgram (std::string _name, std::vector <ServerlessSequence*> _basicBlocks) : ServerlessAction(_name), basicBlocks(_basicBlocks)
+  ServerlessProgram (std::vector <ServerlessSequence*> _basicBlocks) : ServerlessAction(ProgramKind), basicBlocks(_basicBlocks)
   {}
   
+  ServerlessProgram (std::string _name, std::vector <ServerlessSequence*> _basicBlocks) : ServerlessAction(_name, ProgramKind), basicBlocks(_basicBlocks)
+  {}
+  
+  static bool classof (const ServerlessAction* action) {return action->getKind () == ProgramKind;}
+  
   void addBasicBlock (ServerlessSequence* block)
   {
     basicBlocks.push_back (block);
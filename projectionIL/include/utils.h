@@ -1,8 +1,21 @@
 #include <string>
+#include <stdint.h>
 
 #ifndef __UTILS_H__
 #define __UTILS_H__
 
+enum : uint64_t
+{
+  FNV_OFFSET_BASIS = 14695981039346656037ULL,
+  FNV_PRIME = 1099511628211ULL
+};
+
 std::string gen_random_str(const int len);
+uint64_t fnvHash (const std::string& str, uint64_t hash = FNV_OFFSET_BASIS);
+std::string gen_hash_str (uint64_t hash, const int len);
+std::string gen_hash_str (const std::string& content, const int len);
 int getProjectionTempFile (char* file, size_t size);
+std::string unescapeShellString (const std::string& str);
+std::string jsonString (const std::string& str);
+std::string jqAssignment (const std::string& path, const std::string& value);
 #endif 
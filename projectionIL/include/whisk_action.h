@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <istream>
+#include <map>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
+#include <stdio.h>
 #include <string.h>
 #include "utils.h"
 #include "serverless.h"
@@ -10,24 +16,234 @@
 #define WHISK_CLI_PATH "wsk"
 #define WHISK_CLI_ARGS "-i"
 #define ECHO(x) (std::string("echo \"")+x+"\"")
-enum
+typedef ServerlessAction WhiskAction;
+
+class WhiskProgram;
+
+/* Content addressed names.
+ *
+ * Whisk actions are not named when they are created. getName derives the
+ * name from a hash of the code of the action and of the names of the
+ * actions it uses, so every compile of a program produces the same names
+ * and identical projections or forks, in one program or across programs,
+ * are the same deployed action. Basic blocks can refer to each other in a
+ * cycle, so they are named after the structure of the whole program (see
+ * hashStructure) and their position in it instead.
+ *
+ * Names are fixed the first time they are needed, which should be after
+ * fuseProjections has run.
+ */
+
+/* Deployment state.
+ *
+ * The actions deployed for a program, each with a hash of its content,
+ * saved as a JSON object:
+ *   {
+ *     "Fork_A1_...": "9f0c2b7d3e5a1486",
+ *     ...
+ *   }
+ * Given the state of the previous deployment of the program only new or
+ * changed actions are written. The actions of the previous deployment that
+ * are no longer used are its orphans, which can be deleted.
+ */
+class DeploymentState
 {
-  WHISK_FORK_NAME_LENGTH = 10,
-  WHISK_SEQ_NAME_LENGTH = 10,
-  WHISK_PROJ_NAME_LENGTH = 10
+private:
+  std::unordered_map<std::string, std::string> previous;
+  std::map<std::string, std::string> current;
+  int unchanged;
+  
+public:
+  DeploymentState () : unchanged(0)
+  {
+  }
+  
+  //Reads the state of the previous deployment, returns false if it is not
+  //a valid state.
+  bool read (std::istream& is);
+  //Writes the state of the actions recorded since.
+  void write (std::ostream& os);
+  
+  //Records the action, returns false if it was deployed with the same
+  //content before.
+  bool update (const std::string& name, const char* kind, const std::string& content)
+  {
+    char hash[17];
+    
+    snprintf (hash, sizeof (hash), "%016llx",
+              (unsigned long long)fnvHash (content, fnvHash (kind)));
+    current[name] = hash;
+    
+    auto it = previous.find (name);
+    if (it == previous.end () || it->second != hash)
+      return true;
+    
+    unchanged++;
+    return false;
+  }
+  
+  std::vector<std::string> getOrphans ()
+  {
+    std::vector<std::string> orphans;
+    
+    for (auto& action : previous) {
+      if (current.find (action.first) == current.end ())
+        orphans.push_back (action.first);
+    }
+    std::sort (orphans.begin (), orphans.end ());
+    
+    return orphans;
+  }
+  
+  int getNumberOfActions () {return current.size ();}
+  int getNumberOfUnchanged () {return unchanged;}
 };
 
-typedef ServerlessAction WhiskAction;
+/* Actions generated by the current WhiskProgram::generateCommand or
+ * generateManifest. Actions sharing a name have the same content and are
+ * only written once. Outside of a program everything is written.
+ */
+class WhiskEmission
+{
+private:
+  std::unordered_set<std::string> emitted;
+  DeploymentState* state;
+  WhiskEmission* previous;
+  
+  static WhiskEmission*& current ()
+  {
+    static WhiskEmission* emission = nullptr;
+    return emission;
+  }
+  
+public:
+  WhiskEmission (DeploymentState* _state = nullptr) : state (_state), previous (current ())
+  {
+    current () = this;
+  }
+  
+  ~WhiskEmission ()
+  {
+    current () = previous;
+  }
+  
+  //Returns false if an action with this name was already written.
+  static bool firstEmission (const std::string& name)
+  {
+    return current () == nullptr || current ()->emitted.insert (name).second;
+  }
+  
+  //Returns false if the action is unchanged since the previous deployment.
+  static bool changed (const std::string& name, const char* kind, const std::string& content)
+  {
+    if (current () == nullptr || current ()->state == nullptr)
+      return true;
+    
+    return current ()->state->update (name, kind, content);
+  }
+};
+
+/* Deployment manifest.
+ *
+ * Instead of a shell script the backend can describe every action as one
+ * JSON object per line, in the form the CLI sends it:
+ *   {"name": "Proj_...", "exec": {"kind": "projection", "code": "..."}}
+ *   {"name": "Fork_...", "exec": {"kind": "fork", "components": ["A1"]}}
+ *   {"name": "Sequence_...", "exec": {"kind": "sequence", "components": [...]}}
+ *   {"name": "Program_...", "exec": {"kind": "program", "components": [...]}}
+ * An action is always written before the sequences and programs using it.
+ */
+
+inline void writeManifestEntry (std::ostream& os, const std::string& name, const char* kind, const std::string& exec)
+{
+  os << "{\"name\": " << jsonString (name) << ", \"exec\": {\"kind\": \"" << kind << "\", " << exec << "}}\n";
+}
+
+//components is a comma separated list of action names, as passed to
+//--sequence.
+inline std::string manifestComponents (const std::string& components)
+{
+  std::string result = "\"components\": [";
+  size_t start = 0;
+  
+  while (start < components.size ()) {
+    size_t end = components.find (',', start);
+    
+    if (end == std::string::npos)
+      end = components.size ();
+    if (start > 0)
+      result += ", ";
+    result += jsonString (components.substr (start, end - start));
+    start = end + 1;
+  }
+  
+  return result + "]";
+}
 
 class WhiskSequence : public ServerlessSequence
 {
+private:
+  //Set for the basic blocks of a program, which are named after the
+  //program and their position in it.
+  WhiskProgram* program;
+  int blockIndex;
+  
+protected:
+  virtual std::string computeName ();
+  
 public:
-  WhiskSequence(std::string name) : ServerlessSequence (name)
+  WhiskSequence() : ServerlessSequence (), program(nullptr), blockIndex(-1)
+  {
+  }
+  
+  WhiskSequence(std::string name) : ServerlessSequence (name), program(nullptr), blockIndex(-1)
+  {
+  }
+  
+  WhiskSequence(std::string name, std::vector<ServerlessAction*> _actions) : ServerlessSequence(name, _actions),
+    program(nullptr), blockIndex(-1)
+  {
+  }
+  
+  void setBasicBlock (WhiskProgram* _program, int index)
+  {
+    program = _program;
+    blockIndex = index;
+  }
+  
+  uint64_t hashActions (uint64_t hash)
+  {
+    for (auto action : actions) {
+      hash = action->hashStructure (hash);
+    }
+    
+    return hash;
+  }
+  
+  //A basic block is a reference to another block, which is hashed as its
+  //position.
+  virtual uint64_t hashStructure (uint64_t hash)
   {
+    if (program != nullptr)
+      return hashField (std::to_string (blockIndex), hashField ("block", hash));
+    
+    return hashActions (hashField ("sequence", hash));
   }
   
-  WhiskSequence(std::string name, std::vector<ServerlessAction*> _actions) : ServerlessSequence(name, _actions)
+  int fuseProjections (bool foldResultProjections);
+  
+  //Comma separated names of the actions, as passed to --sequence.
+  std::string getComponents ()
   {
+    std::string components;
+    
+    for (auto action : actions) {
+      if (components.size () > 0)
+        components += ",";
+      components += action->getNameForSeq ();
+    }
+    
+    return components;
   }
   
   virtual void print ()
@@ -44,67 +260,255 @@ public:
   
   virtual void generateCommand(std::ostream& os)
   {
+    if (!WhiskEmission::firstEmission (getName ()))
+      return;
+    
     for (auto action : actions) {
       action->generateCommand (os);
     }
     
+    std::string components = getComponents ();
+    if (!WhiskEmission::changed (getName (), "sequence", components))
+      return;
+    
     os << WHISK_CLI_PATH << " " << WHISK_CLI_ARGS << " action update " << getName () << " --sequence ";
     if (actions.size () > 0) {
-      for (int i = 0; i < actions.size () - 1; i++) {
-        os << actions[i]->getNameForSeq () << ",";
-      }
-      
-      os << actions[actions.size () - 1]->getNameForSeq () << std::endl;
+      os << components << std::endl;
+    }
+  }
+  
+  virtual void generateManifest (std::ostream& os)
+  {
+    if (!WhiskEmission::firstEmission (getName ()))
+      return;
+    
+    for (auto action : actions) {
+      action->generateManifest (os);
     }
+    
+    std::string components = getComponents ();
+    if (WhiskEmission::changed (getName (), "sequence", components))
+      writeManifestEntry (os, getName (), "sequence", manifestComponents (components));
   }
 };
 
 class WhiskProjection : public ServerlessProjection
 {
+private:
+  //Projections composed into this one by fuseProjections. The code is put
+  //together when it is needed, as it can refer to basic blocks.
+  std::vector<WhiskProjection*> parts;
+  
+protected:
+  WhiskProjection (ActionKind kind) : ServerlessProjection (kind)
+  {
+  }
+  
 public:
-
-  WhiskProjection (std::string name, std::string _code) : ServerlessProjection (name, _code) 
+  WhiskProjection (std::string _code) : ServerlessProjection (_code) 
   {
   }
-
+  
+  WhiskProjection (std::vector<WhiskProjection*> _parts) : ServerlessProjection (ProjectionKind), parts(_parts)
+  {
+  }
+  
+  virtual std::string getProjCode ()
+  {
+    std::string code;
+    
+    if (parts.empty ())
+      return projCode;
+    
+    for (size_t i = 0; i < parts.size (); i++) {
+      if (i > 0)
+        code += " | ";
+      code += "(" + parts[i]->getProjCode () + ")";
+    }
+    
+    return code;
+  }
+  
+  virtual uint64_t hashStructure (uint64_t hash)
+  {
+    if (parts.empty ())
+      return hashField (projCode, hashField ("projection", hash));
+    
+    hash = hashField ("composition", hash);
+    for (auto part : parts) {
+      hash = part->hashStructure (hash);
+    }
+    
+    return hash;
+  }
+  
   virtual void generateCommand(std::ostream& os)
   {
+    if (!WhiskEmission::firstEmission (getName ()) ||
+        !WhiskEmission::changed (getName (), "projection", getProjCode ()))
+      return;
+    
     char temp[256];
     assert (getProjectionTempFile (temp, 256) != -1);
     os << ECHO(getProjCode ()) << " > " << temp << "\n";
     os << WHISK_CLI_PATH << " " << WHISK_CLI_ARGS << " action update " << getName () << " --projection " << temp << "\n";
   }
+  
+  virtual void generateManifest (std::ostream& os)
+  {
+    if (!WhiskEmission::firstEmission (getName ()) ||
+        !WhiskEmission::changed (getName (), "projection", getProjCode ()))
+      return;
+    
+    writeManifestEntry (os, getName (), "projection",
+                        "\"code\": " + jsonString (unescapeShellString (getProjCode ())));
+  }
+};
+
+//Projection choosing the basic block to run next, elseTarget is nullptr
+//for a direct branch. The copy code of a target, if any, sets the PHIs of
+//that target on the way to it.
+class WhiskBranchProjection : public WhiskProjection
+{
+private:
+  std::string condition;
+  ServerlessAction* thenTarget;
+  ServerlessAction* elseTarget;
+  std::string thenCopies;
+  std::string elseCopies;
+  
+  //Sets the action to run next after the copies.
+  static std::string getTargetCode (ServerlessAction* target, const std::string& copies)
+  {
+    std::string code = jqAssignment (".action", R"(\")" + std::string (target->getName ()) + R"(\")");
+    
+    if (copies == "")
+      return code;
+    
+    return copies + " | " + code;
+  }
+  
+public:
+  WhiskBranchProjection (ServerlessAction* target, std::string copies = "") : WhiskProjection (BranchProjectionKind),
+    thenTarget(target), elseTarget(nullptr), thenCopies(copies)
+  {
+  }
+  
+  WhiskBranchProjection (std::string _condition, ServerlessAction* _thenTarget, ServerlessAction* _elseTarget,
+                         std::string _thenCopies = "", std::string _elseCopies = "") :
+    WhiskProjection (BranchProjectionKind), condition(_condition), thenTarget(_thenTarget), elseTarget(_elseTarget),
+    thenCopies(_thenCopies), elseCopies(_elseCopies)
+  {
+  }
+  
+  static bool classof (const ServerlessAction* action) {return action->getKind () == BranchProjectionKind;}
+  
+  virtual std::string getProjCode ()
+  {
+    if (elseTarget == nullptr)
+      return getTargetCode (thenTarget, thenCopies); //TODO: Wrap correctly in app.
+    
+    return "if (" + condition + ") then (" + getTargetCode (thenTarget, thenCopies) +
+      ") else (" + getTargetCode (elseTarget, elseCopies) + ")";
+  }
+  
+  virtual uint64_t hashStructure (uint64_t hash)
+  {
+    hash = hashField (condition, hashField ("branch", hash));
+    hash = thenTarget->hashStructure (hashField (thenCopies, hash));
+    if (elseTarget != nullptr)
+      hash = elseTarget->hashStructure (hashField (elseCopies, hash));
+    
+    return hash;
+  }
 };
 
 class WhiskFork : public ServerlessFork
 {
+private:
+  bool resultProjectionFolded;
+  
 public:
-  WhiskFork (std::string name, std::string _innerActionName, std::string _returnName, std::string requiredFields) : ServerlessFork (name, _innerActionName, _returnName, requiredFields)
+  WhiskFork (std::string _innerActionName, std::string _returnName, std::string requiredFields) : ServerlessFork (_innerActionName, _returnName, requiredFields),
+    resultProjectionFolded(false)
+  {
+  }
+  
+  WhiskFork (ServerlessAction* _innerAction, std::string _returnName, std::string requiredFields) : ServerlessFork (_innerAction, _returnName, requiredFields),
+    resultProjectionFolded(false)
+  {
+  }
+  
+  //jq code saving the result of the call in .saved.
+  std::string getResultProjectionCode ()
+  {
+    if (requiredFields != "") {
+      return jqAssignment (".saved." + returnName, requiredFields);
+    } else {
+      return jqAssignment (".saved." + returnName, ".input");
+    }
+  }
+  
+  //Named like a WhiskProjection with the same code.
+  std::string getResultProjectionName ()
+  {
+    if (resultProjectionName.empty ())
+      resultProjectionName = "Proj_" + gen_hash_str (getResultProjectionCode (), WHISK_PROJ_NAME_LENGTH);
+    
+    return resultProjectionName;
+  }
+  
+  bool isResultProjectionFolded () {return resultProjectionFolded;}
+  
+  //Returns the result projection as an action of its own, which the caller
+  //places after the fork. The fork then no longer generates it.
+  WhiskProjection* foldResultProjection ()
   {
+    resultProjectionFolded = true;
+    return arenaNew<WhiskProjection> (getResultProjectionCode ());
   }
   
-  WhiskFork (std::string name, ServerlessAction* _innerAction, std::string _returnName, std::string requiredFields) : ServerlessFork (name, _innerAction, _returnName, requiredFields)
+  virtual uint64_t hashStructure (uint64_t hash)
   {
+    hash = hashField (getInnerActionName (), hashField ("fork", hash));
+    if (!resultProjectionFolded)
+      hash = hashField (getResultProjectionCode (), hash);
+    
+    return hash;
   }
   
   virtual void generateCommand(std::ostream& os)
   {
-    os << WHISK_CLI_PATH << " " << WHISK_CLI_ARGS << " action update " <<
-      getName() << " --fork " << getInnerActionName() << std::endl;
+    if (WhiskEmission::firstEmission (getName ()) &&
+        WhiskEmission::changed (getName (), "fork", getInnerActionName ())) {
+      os << WHISK_CLI_PATH << " " << WHISK_CLI_ARGS << " action update " <<
+        getName() << " --fork " << getInnerActionName() << std::endl;
+    }
+    
+    if (resultProjectionFolded || !WhiskEmission::firstEmission (getResultProjectionName ()) ||
+        !WhiskEmission::changed (getResultProjectionName (), "projection", getResultProjectionCode ()))
+      return;
     
     char temp[256];
     assert (getProjectionTempFile (temp, 256) != -1);
-    char code[2048];
-    resultProjectionName = "Proj_"+gen_random_str (WHISK_PROJ_NAME_LENGTH);
-    if (requiredFields != "") {
-      sprintf (code, R"(. * {\"saved\": {\"%s\": %s}})", returnName.c_str(), requiredFields.c_str ());
-    } else {
-      sprintf (code, R"(. * {\"saved\": {\"%s\": .input}})", returnName.c_str());
-    }
-    os << ECHO(code) << " > " << temp << std::endl;
+    os << ECHO(getResultProjectionCode ()) << " > " << temp << std::endl;
     os << WHISK_CLI_PATH << " " WHISK_CLI_ARGS << " action update " << 
        resultProjectionName << " --projection " << temp << std::endl;
   }
+  
+  virtual void generateManifest (std::ostream& os)
+  {
+    if (WhiskEmission::firstEmission (getName ()) &&
+        WhiskEmission::changed (getName (), "fork", getInnerActionName ()))
+      writeManifestEntry (os, getName (), "fork", manifestComponents (getInnerActionName ()));
+    
+    if (resultProjectionFolded || !WhiskEmission::firstEmission (getResultProjectionName ()) ||
+        !WhiskEmission::changed (getResultProjectionName (), "projection", getResultProjectionCode ()))
+      return;
+    
+    writeManifestEntry (os, getResultProjectionName (), "projection",
+                        "\"code\": " + jsonString (unescapeShellString (getResultProjectionCode ())));
+  }
 };
 
 class WhiskProjForkPair : public ServerlessAction
@@ -113,13 +517,29 @@ private:
   WhiskFork* fork;
   WhiskProjection* proj;
 
+protected:
+  virtual std::string computeName ()
+  {
+    return "ProjForkPair_" + gen_hash_str (getNameForSeq (), WHISK_FORK_NAME_LENGTH);
+  }
+  
 public:
   WhiskProjForkPair (WhiskProjection* _proj, WhiskFork* _fork):
-    WhiskAction ("ProjForkPair_" + gen_random_str (WHISK_FORK_NAME_LENGTH)),
-    fork(_fork), proj(_proj)
+    WhiskAction (ProjForkPairKind), fork(_fork), proj(_proj)
+  {
+  }
+  
+  virtual uint64_t hashStructure (uint64_t hash)
   {
+    return fork->hashStructure (proj->hashStructure (hash));
   }
   
+  static bool classof (const ServerlessAction* action) {return action->getKind () == ProjForkPairKind;}
+  
+  WhiskProjection* getProjection () {return proj;}
+  void setProjection (WhiskProjection* _proj) {proj = _proj;}
+  WhiskFork* getFork () {return fork;}
+  
   virtual void print ()
   {
     proj->print ();
@@ -133,7 +553,19 @@ public:
     fork->generateCommand(os);
   }
   
-  virtual std::string getNameForSeq () {return proj->getName () + std::string(",") + fork->getName () + "," + fork->getResultProjectionName();}
+  virtual void generateManifest (std::ostream& os)
+  {
+    proj->generateManifest (os);
+    fork->generateManifest (os);
+  }
+  
+  virtual std::string getNameForSeq ()
+  {
+    if (fork->isResultProjectionFolded ())
+      return proj->getName () + std::string(",") + fork->getName ();
+    
+    return proj->getName () + std::string(",") + fork->getName () + "," + fork->getResultProjectionName();
+  }
 };
 
 typedef ServerlessApp WhiskApp;
@@ -141,20 +573,24 @@ typedef ServerlessApp WhiskApp;
 class WhiskDirectBranch : public ServerlessApp
 {
 private:
-  std::string target;
+  ServerlessAction* target;
   WhiskProjection* proj;
   
 public:
-  WhiskDirectBranch (std::string _target) : target(_target)
+  WhiskDirectBranch (ServerlessAction* _target, std::string copies = "") : ServerlessApp (DirectBranchKind), target(_target)
   {
-    proj = new WhiskProjection ("Proj_DirectBranch_" +gen_random_str (WHISK_PROJ_NAME_LENGTH), 
-                       R"(. * {\"action\":\")" + target+R"(\"})"); //TODO: Wrap correctly in app.
-    
+    proj = arenaNew<WhiskBranchProjection> (target, copies);
   }
   
+  static bool classof (const ServerlessAction* action) {return action->getKind () == DirectBranchKind;}
+  
+  WhiskProjection* getProjection () {return proj;}
+  
+  virtual uint64_t hashStructure (uint64_t hash) {return proj->hashStructure (hash);}
+  
   virtual void print ()
   {
-    fprintf (stdout, "App (%s)", target.c_str ());
+    fprintf (stdout, "App (%s)", target->getName ());
   }
   
   virtual void generateCommand (std::ostream& os)
@@ -163,36 +599,117 @@ public:
     //os << WHISK_CLI_PATH << " " << WHISK_CLI_ARGS << " action invoke " << getName () << std::endl;
   }
   
+  virtual void generateManifest (std::ostream& os)
+  {
+    proj->generateManifest (os);
+  }
+  
   virtual std::string getNameForSeq () {return std::string(proj->getName ());}
 };
 
 class WhiskProgram : public ServerlessProgram 
 {
+private:
+  uint64_t structureHash;
+  bool structureHashed;
+  DeploymentState* deploymentState;
+  
+protected:
+  virtual std::string computeName ()
+  {
+    return "Program_" + gen_hash_str (getStructureHash (), WHISK_SEQ_NAME_LENGTH);
+  }
+  
 public:
-  WhiskProgram (std::string _name) : ServerlessProgram (_name)
+  WhiskProgram (std::string _name) : ServerlessProgram (_name), structureHashed(false),
+    deploymentState(nullptr)
+  {
+  }
+  
+  WhiskProgram (std::vector <WhiskSequence*> _basicBlocks) : 
+    ServerlessProgram (std::vector<ServerlessSequence*> (_basicBlocks.begin(), _basicBlocks.end())),
+    structureHashed(false), deploymentState(nullptr)
+  {
+    for (size_t i = 0; i < _basicBlocks.size (); i++) {
+      _basicBlocks[i]->setBasicBlock (this, i);
+    }
+  }
+  
+  //Hash of the code of every basic block in order, with references between
+  //blocks replaced by their positions.
+  uint64_t getStructureHash ()
+  {
+    if (!structureHashed) {
+      structureHash = FNV_OFFSET_BASIS;
+      for (auto block : basicBlocks) {
+        structureHash = ((WhiskSequence*)block)->hashActions (hashField ("block", structureHash));
+      }
+      structureHashed = true;
+    }
+    
+    return structureHash;
+  }
+  
+  //Records the generated actions in state and only generates the ones
+  //changed since the deployment state was read.
+  void setDeploymentState (DeploymentState* state) {deploymentState = state;}
+  
+  //Fuses the projections of every basic block, returns the number of
+  //action hops removed.
+  int fuseProjections (bool foldResultProjections)
   {
+    int removed = 0;
+    
+    for (auto block : basicBlocks) {
+      removed += ((WhiskSequence*)block)->fuseProjections (foldResultProjections);
+    }
+    
+    return removed;
   }
   
-  WhiskProgram (std::string _name, std::vector <WhiskSequence*> _basicBlocks) : 
-    ServerlessProgram (_name, std::vector<ServerlessSequence*> (_basicBlocks.begin(), _basicBlocks.end()))
+  std::string getComponents ()
   {
+    std::string components;
+    
+    for (auto block : basicBlocks) {
+      if (components.size () > 0)
+        components += ",";
+      components += block->getNameForSeq ();
+    }
+    
+    return components;
   }
   
   virtual void generateCommand(std::ostream& os)
   {
+    WhiskEmission emission (deploymentState);
+    
     for (auto block : basicBlocks) {
       block->generateCommand (os);
-      std::cout << std::endl;
+      os << std::endl;
     }
     
+    std::string components = getComponents ();
+    if (!WhiskEmission::changed (getName (), "program", components))
+      return;
+    
     os << WHISK_CLI_PATH << " " << WHISK_CLI_ARGS << " action update " << getName () << " --program ";
     if (basicBlocks.size () > 0) {
-      for (int i = 0; i < basicBlocks.size () - 1; i++) {
-        os << basicBlocks[i]->getNameForSeq () << ",";
-      }
-      
-      os << basicBlocks[basicBlocks.size () - 1]->getNameForSeq () << std::endl;
+      os << components << std::endl;
+    }
+  }
+  
+  virtual void generateManifest (std::ostream& os)
+  {
+    WhiskEmission emission (deploymentState);
+    
+    for (auto block : basicBlocks) {
+      block->generateManifest (os);
     }
+    
+    std::string components = getComponents ();
+    if (WhiskEmission::changed (getName (), "program", components))
+      writeManifestEntry (os, getName (), "program", manifestComponents (components));
   }
   
   virtual void print ()
@@ -207,4 +724,102 @@ public:
     fprintf (stdout, "))\n");
   }
 };
+
+inline std::string WhiskSequence::computeName ()
+{
+  std::string components;
+  
+  if (program != nullptr) {
+    return "Sequence_" + gen_hash_str (hashField (std::to_string (blockIndex), program->getStructureHash ()),
+                                       WHISK_SEQ_NAME_LENGTH);
+  }
+  
+  for (auto action : actions) {
+    components += action->getNameForSeq () + ",";
+  }
+  
+  return "Sequence_" + gen_hash_str (components, WHISK_SEQ_NAME_LENGTH);
+}
+
+//Composes run, a list of consecutive projections, into one jq program.
+inline WhiskProjection* composeProjections (std::vector<WhiskProjection*>& run)
+{
+  if (run.size () == 1)
+    return run[0];
+  
+  return arenaNew<WhiskProjection> (run);
+}
+
+/* Projection fusion.
+ *
+ * Each projection in a sequence is an action hop of its own at run time.
+ * Consecutive projections, including direct branches and conditional
+ * sequences holding a single projection, are replaced by their composition,
+ * and a run directly before a fork is composed into the projection of the
+ * fork's input, so that a straight line run between forks costs one hop.
+ *
+ * With foldResultProjections the projection saving a call's result starts
+ * the run after its fork, so a chain of N calls needs N+1 projections
+ * instead of 2N.
+ */
+inline int WhiskSequence::fuseProjections (bool foldResultProjections)
+{
+  std::vector<ServerlessAction*> fused;
+  std::vector<WhiskProjection*> run;
+  int removed = 0;
+  
+  for (auto action : actions) {
+    switch (action->getKind ()) {
+      case ProjectionKind:
+      case BranchProjectionKind:
+        run.push_back (cast<WhiskProjection> (action));
+        continue;
+      case DirectBranchKind:
+        run.push_back (cast<WhiskDirectBranch> (action)->getProjection ());
+        continue;
+      case SequenceKind: {
+        WhiskSequence* seq = cast<WhiskSequence> (action);
+        
+        removed += seq->fuseProjections (foldResultProjections);
+        if (seq->actions.size () == 1 && isa<WhiskProjection> (seq->actions[0])) {
+          run.push_back (cast<WhiskProjection> (seq->actions[0]));
+          continue;
+        }
+        break;
+      }
+      case ProjForkPairKind: {
+        WhiskProjForkPair* pair = cast<WhiskProjForkPair> (action);
+        
+        if (run.size () > 0) {
+          run.push_back (pair->getProjection ());
+          removed += run.size () - 1;
+          pair->setProjection (composeProjections (run));
+          run.clear ();
+        }
+        fused.push_back (pair);
+        if (foldResultProjections)
+          run.push_back (pair->getFork ()->foldResultProjection ());
+        continue;
+      }
+      default:
+        break;
+    }
+    
+    if (run.size () > 0) {
+      removed += run.size () - 1;
+      fused.push_back (composeProjections (run));
+      run.clear ();
+    }
+    fused.push_back (action);
+  }
+  
+  if (run.size () > 0) {
+    removed += run.size () - 1;
+    fused.push_back (composeProjections (run));
+  }
+  
+  actions = fused;
+  return removed;
+}
+
 #endif
@@ -0,0 +1,119 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+Arena* Arena::currentArena = nullptr;
+size_t Arena::numberOfPoolTypes = 0;
+CompilationArena* CompilationArena::currentCompilation = nullptr;
+size_t CompilationArena::lastPeakBytes = 0;
+
+static char* alignUp (char* ptr, size_t align)
+{
+  uintptr_t addr = (uintptr_t) ptr;
+
+  return (char*) ((addr + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+Arena::Arena () : next (nullptr), end (nullptr), bytesAllocated (0),
+                  bytesReserved (0), peakBytes (0)
+{
+}
+
+Arena::~Arena ()
+{
+  release ();
+}
+
+char* Arena::allocateChunk (size_t size)
+{
+  char* start = (char*) malloc (size);
+
+  if (start == nullptr) {
+    fprintf (stderr, "Arena: cannot allocate chunk of %zu bytes\n", size);
+    abort ();
+  }
+
+  chunks.push_back (Chunk {start, size});
+  bytesReserved += size;
+
+  return start;
+}
+
+void Arena::countBytes (size_t size)
+{
+  bytesAllocated += size;
+  if (bytesAllocated > peakBytes)
+    peakBytes = bytesAllocated;
+}
+
+char* Arena::allocateFromChunk (size_t size, size_t align)
+{
+  char* ptr = alignUp (next, align);
+
+  if (next == nullptr || ptr + size > end) {
+    if (size + align > ARENA_CHUNK_SIZE) {
+      //Large requests get a chunk of their own and do not disturb
+      //the current bump pointer.
+      return alignUp (allocateChunk (size + align), align);
+    }
+
+    next = allocateChunk (ARENA_CHUNK_SIZE);
+    end = next + ARENA_CHUNK_SIZE;
+    ptr = alignUp (next, align);
+  }
+
+  next = ptr + size;
+
+  return ptr;
+}
+
+void* Arena::allocate (size_t size, size_t align)
+{
+  countBytes (size);
+
+  return allocateFromChunk (size, align);
+}
+
+void* Arena::allocateFromPool (size_t poolIndex, size_t size, size_t align)
+{
+  if (poolIndex >= pools.size ()) {
+    pools.resize (poolIndex + 1, Pool {nullptr, nullptr});
+  }
+
+  Pool& pool = pools[poolIndex];
+
+  if (pool.next == nullptr || pool.next + size > pool.end) {
+    //sizeof (T) is always a multiple of alignof (T), so every slot of
+    //the slab stays aligned.
+    size_t slabSize = size * ARENA_POOL_SLAB_OBJECTS;
+
+    pool.next = allocateFromChunk (slabSize, align);
+    pool.end = pool.next + slabSize;
+  }
+
+  void* ptr = pool.next;
+  pool.next += size;
+  countBytes (size);
+
+  return ptr;
+}
+
+void Arena::release ()
+{
+  for (auto iter = destructors.rbegin (); iter != destructors.rend (); ++iter) {
+    iter->destroy (iter->object);
+  }
+
+  for (auto chunk : chunks) {
+    free (chunk.start);
+  }
+
+  destructors.clear ();
+  chunks.clear ();
+  pools.clear ();
+  next = end = nullptr;
+  bytesAllocated = 0;
+  bytesReserved = 0;
+}
@@ -13,99 +13,99 @@ void JSONIdentifier::setCallStmt(CallAction* _callStmt)
   callStmt = _callStmt;
 }
 
-CallAction* Action::operator () (JSONIdentifier* out, JSONIdentifier* in)
+CallAction* Action::operator () (JSONIdentifier* out, JSONExpression* in)
 {
-  return new CallAction (out, name, in);
+  return arenaNew<CallAction> (out, name, in);
 }
 
 JSONPatternApplication& JSONExpression::getField (std::string fieldName)
 {
-  return *(new JSONPatternApplication (this, new FieldGetJSONPattern (fieldName)));
+  return *(arenaNew<JSONPatternApplication> (this, arenaNew<FieldGetJSONPattern> (fieldName)));
 }
 
 JSONPatternApplication& JSONExpression::operator [] (std::string key)
 {
-  return *(new JSONPatternApplication (this, new KeyGetJSONPattern (key)));
+  return *(arenaNew<JSONPatternApplication> (this, arenaNew<KeyGetJSONPattern> (key)));
 }
 
 JSONPatternApplication& JSONExpression::operator [] (const char* key)
 {
-  return *(new JSONPatternApplication (this, new KeyGetJSONPattern (std::string(key))));
+  return *(arenaNew<JSONPatternApplication> (this, arenaNew<KeyGetJSONPattern> (std::string(key))));
 }
 
 JSONPatternApplication& JSONExpression::operator [] (int index)
 {
-  return *(new JSONPatternApplication (this, new ArrayIndexJSONPattern (index)));
+  return *(arenaNew<JSONPatternApplication> (this, arenaNew<ArrayIndexJSONPattern> (index)));
 }
 
 JSONConditional& JSONExpression::operator== (std::string value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::EQ, new StringExpression (value)));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::EQ, arenaNew<StringExpression> (value)));
 }
 
 JSONConditional& JSONExpression::operator== (float value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::EQ, new NumberExpression (value)));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::EQ, arenaNew<NumberExpression> (value)));
 }
 
 JSONConditional& JSONExpression::operator== (int value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::EQ, new NumberExpression (value)));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::EQ, arenaNew<NumberExpression> (value)));
 }
 
 JSONConditional& JSONExpression::operator== (bool value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::EQ, new BooleanExpression (value)));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::EQ, arenaNew<BooleanExpression> (value)));
 }
 
 JSONConditional& JSONExpression::operator== (JSONExpression& value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::EQ, &value));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::EQ, &value));
 }
 
 JSONConditional& JSONExpression::operator!= (std::string value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::NE, new StringExpression (value)));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::NE, arenaNew<StringExpression> (value)));
 }
 
 JSONConditional& JSONExpression::operator!= (float value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::NE, new NumberExpression (value)));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::NE, arenaNew<NumberExpression> (value)));
 }
 
 JSONConditional& JSONExpression::operator!= (int value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::NE, new NumberExpression (value)));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::NE, arenaNew<NumberExpression> (value)));
 }
 
 JSONConditional& JSONExpression::operator!= (bool value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::NE, new BooleanExpression (value)));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::NE, arenaNew<BooleanExpression> (value)));
 }
 
 JSONConditional& JSONExpression::operator!= (JSONExpression& value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::NE, &value));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::NE, &value));
 }
 
 JSONConditional& JSONExpression::operator>= (float value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::GE, new NumberExpression (value)));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::GE, arenaNew<NumberExpression> (value)));
 }
 
 JSONConditional& JSONExpression::operator> (float value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::GT, new NumberExpression (value)));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::GT, arenaNew<NumberExpression> (value)));
 }
 
 JSONConditional& JSONExpression::operator<= (float value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::LE, new NumberExpression (value)));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::LE, arenaNew<NumberExpression> (value)));
 }
 
 JSONConditional& JSONExpression::operator< (float value)
 {
-  return *(new JSONConditional (this, ConditionalOperator::LT, new NumberExpression (value)));
+  return *(arenaNew<JSONConditional> (this, ConditionalOperator::LT, arenaNew<NumberExpression> (value)));
 }
 
 void printConditionalOperator (std::ostream& os, ConditionalOperator op)
@@ -0,0 +1,195 @@
+#include "dominators.h"
+#include "ssa.h"
+
+#include <utility>
+
+DominatorTree::DominatorTree (BasicBlock* entry)
+{
+  computeReversePostOrder (entry);
+  computeIDoms ();
+  computeFrontiers ();
+  numberTree ();
+}
+
+void DominatorTree::computeReversePostOrder (BasicBlock* entry)
+{
+  //Iterative DFS, generated programs can nest deeper than the call stack.
+  //Successors are visited last to first so that the then branch of a
+  //conditional ends up before its else branch in reverse postorder.
+  std::vector <std::pair <BasicBlock*, int>> stack;
+  std::unordered_map <BasicBlock*, bool> visited;
+  BasicBlocks postOrder;
+
+  stack.push_back (std::make_pair (entry, (int)entry->getSuccessors ().size ()));
+  visited[entry] = true;
+  while (stack.empty () == false) {
+    BasicBlock* bb = stack.back ().first;
+    int& next = stack.back ().second;
+
+    if (next == 0) {
+      postOrder.push_back (bb);
+      stack.pop_back ();
+      continue;
+    }
+
+    BasicBlock* succ = bb->getSuccessors ()[--next];
+    if (visited.count (succ) == 0) {
+      visited[succ] = true;
+      stack.push_back (std::make_pair (succ, (int)succ->getSuccessors ().size ()));
+    }
+  }
+
+  reversePostOrder.assign (postOrder.rbegin (), postOrder.rend ());
+  for (int i = 0; i < (int)reversePostOrder.size (); i++) {
+    rpoNumber[reversePostOrder[i]] = i;
+  }
+}
+
+int DominatorTree::intersect (int b1, int b2)
+{
+  while (b1 != b2) {
+    while (b1 > b2)
+      b1 = idoms[b1];
+    while (b2 > b1)
+      b2 = idoms[b2];
+  }
+
+  return b1;
+}
+
+void DominatorTree::computeIDoms ()
+{
+  bool changed = true;
+
+  idoms.assign (reversePostOrder.size (), -1);
+  idoms[0] = 0;
+
+  while (changed) {
+    changed = false;
+    for (int b = 1; b < (int)reversePostOrder.size (); b++) {
+      int newIDom = -1;
+
+      for (auto pred : reversePostOrder[b]->getPredecessors ()) {
+        auto iter = rpoNumber.find (pred);
+        if (iter == rpoNumber.end () || idoms[iter->second] == -1)
+          continue;
+        if (newIDom == -1)
+          newIDom = iter->second;
+        else
+          newIDom = intersect (iter->second, newIDom);
+      }
+
+      if (idoms[b] != newIDom) {
+        idoms[b] = newIDom;
+        changed = true;
+      }
+    }
+  }
+
+  children.assign (reversePostOrder.size (), BasicBlocks ());
+  for (int b = 1; b < (int)reversePostOrder.size (); b++) {
+    children[idoms[b]].push_back (reversePostOrder[b]);
+  }
+}
+
+void DominatorTree::computeFrontiers ()
+{
+  frontiers.assign (reversePostOrder.size (), BasicBlocks ());
+
+  for (int b = 0; b < (int)reversePostOrder.size (); b++) {
+    BasicBlock* bb = reversePostOrder[b];
+    std::vector<int> preds;
+
+    for (auto pred : bb->getPredecessors ()) {
+      auto iter = rpoNumber.find (pred);
+      if (iter != rpoNumber.end ())
+        preds.push_back (iter->second);
+    }
+
+    if (preds.size () < 2)
+      continue;
+
+    for (int runner : preds) {
+      while (runner != idoms[b]) {
+        //Blocks are visited in order, so a duplicate can only be the last
+        //one added.
+        if (frontiers[runner].empty () || frontiers[runner].back () != bb)
+          frontiers[runner].push_back (bb);
+        runner = idoms[runner];
+      }
+    }
+  }
+}
+
+void DominatorTree::numberTree ()
+{
+  std::vector <std::pair <int, int>> stack;
+  int counter = 0;
+
+  treeIn.assign (reversePostOrder.size (), 0);
+  treeOut.assign (reversePostOrder.size (), 0);
+
+  stack.push_back (std::make_pair (0, 0));
+  treeIn[0] = counter++;
+  while (stack.empty () == false) {
+    int b = stack.back ().first;
+    int& next = stack.back ().second;
+
+    if (next == (int)children[b].size ()) {
+      treeOut[b] = counter++;
+      stack.pop_back ();
+      continue;
+    }
+
+    int child = rpoNumber[children[b][next++]];
+    treeIn[child] = counter++;
+    stack.push_back (std::make_pair (child, 0));
+  }
+}
+
+BasicBlock* DominatorTree::getIDom (BasicBlock* bb)
+{
+  int b = rpoNumber.at (bb);
+
+  if (b == 0)
+    return nullptr;
+
+  return reversePostOrder[idoms[b]];
+}
+
+const DominatorTree::BasicBlocks& DominatorTree::getChildren (BasicBlock* bb)
+{
+  auto iter = rpoNumber.find (bb);
+
+  if (iter == rpoNumber.end ())
+    return empty;
+
+  return children[iter->second];
+}
+
+const DominatorTree::BasicBlocks& DominatorTree::getDominanceFrontier (BasicBlock* bb)
+{
+  auto iter = rpoNumber.find (bb);
+
+  if (iter == rpoNumber.end ())
+    return empty;
+
+  return frontiers[iter->second];
+}
+
+bool DominatorTree::dominates (BasicBlock* a, BasicBlock* b)
+{
+  auto iterA = rpoNumber.find (a);
+  auto iterB = rpoNumber.find (b);
+
+  if (iterA == rpoNumber.end () || iterB == rpoNumber.end ())
+    return false;
+
+  return treeIn[iterA->second] <= treeIn[iterB->second] &&
+         treeOut[iterB->second] <= treeOut[iterA->second];
+}
+
+BasicBlock* DominatorTree::nearestCommonDominator (BasicBlock* a, BasicBlock* b)
+{
+  return reversePostOrder[intersect (rpoNumber.at (a), rpoNumber.at (b))];
+}
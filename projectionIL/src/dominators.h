@@ -0,0 +1,55 @@
+#include <vector>
+#include <unordered_map>
+
+#ifndef __DOMINATORS_H__
+#define __DOMINATORS_H__
+
+class BasicBlock;
+
+/* Dominator tree and dominance frontiers of the blocks reachable from an
+ * entry block.
+ *
+ * Immediate dominators are computed with the iterative algorithm of Cooper,
+ * Harvey and Kennedy ("A Simple, Fast Dominance Algorithm") over reverse
+ * postorder, and the frontiers from the idoms of the join blocks. Blocks
+ * which are not reachable from the entry are not part of the tree.
+ */
+class DominatorTree
+{
+private:
+  typedef std::vector<BasicBlock*> BasicBlocks;
+
+  BasicBlocks reversePostOrder;
+  std::unordered_map <BasicBlock*, int> rpoNumber;
+  //Indexed by reverse postorder number, the entry is its own idom.
+  std::vector<int> idoms;
+  std::vector<BasicBlocks> children;
+  std::vector<BasicBlocks> frontiers;
+  //Pre and post order numbers of the dominator tree walk, a dominates b
+  //iff b is numbered within a's interval.
+  std::vector<int> treeIn;
+  std::vector<int> treeOut;
+  BasicBlocks empty;
+
+  void computeReversePostOrder (BasicBlock* entry);
+  void computeIDoms ();
+  void computeFrontiers ();
+  void numberTree ();
+  int intersect (int b1, int b2);
+
+public:
+  DominatorTree (BasicBlock* entry);
+
+  BasicBlock* getEntry () {return reversePostOrder[0];}
+  const BasicBlocks& getReversePostOrder () {return reversePostOrder;}
+  bool isReachable (BasicBlock* bb) {return rpoNumber.count (bb) == 1;}
+  //Returns nullptr for the entry block.
+  BasicBlock* getIDom (BasicBlock* bb);
+  const BasicBlocks& getChildren (BasicBlock* bb);
+  const BasicBlocks& getDominanceFrontier (BasicBlock* bb);
+  bool dominates (BasicBlock* a, BasicBlock* b);
+  //The deepest block dominating both reachable blocks a and b.
+  BasicBlock* nearestCommonDominator (BasicBlock* a, BasicBlock* b);
+};
+
+#endif /*__DOMINATORS_H__*/
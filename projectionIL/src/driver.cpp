@@ -1,17 +1,24 @@
 #include "driver.h"
 #include "ssa.h"
+#include "dominators.h"
+#include "loops.h"
 
 #include <vector>
 #include <string>
 #include <iostream>
 #include <typeinfo>
 #include <set>
+#include <map>
 #include <utility>
 #include <queue>
 #include <algorithm>
 #include <sstream>
+#include <fstream>
+#include <unistd.h>
 
 #define MAX_SEQ_NAME_SIZE 10
+//Longest run of unread array elements written as null literals.
+#define MAX_NULL_ELEMENTS 8
 #define READ_VERSION -1
 #define WRITE_VERSION -2
 
@@ -19,7 +26,7 @@
   #error "READ_VERSION and WRITE_VERSION are same."
 #endif
 
-//TODO: Instead of dynamic_cast use maybe enums?
+//TODO-DONE: Instead of dynamic_cast use maybe enums?
 //TODO: Make this language embedded in C++. Get rid of pointers?
 //TODO: Add Logical Operators
 //TODO-DONE: Add ConditionExpression in both IL and SSA
@@ -27,19 +34,21 @@
 //TODO: Add test cases
 //TODO: Add complex pattern so as to decrease number of projection action generation
 
-typedef std::unordered_map <std::string, int> VersionMap;
-typedef std::unordered_map <BasicBlock*, std::unordered_map <std::string, int> > BasicBlockVersionMap;
-typedef std::unordered_map <Identifier*, std::vector<std::pair <BasicBlock*, Identifier*>>> PHINodePair;
+typedef std::unordered_map <Symbol, int> VersionMap;
 
 int getProjectionTempFile (char* file, size_t size)
 {
   char temp[] = "/tmp/wsk-proj-XXXXXX";
-  if (mkstemp(&temp[0]) == -1) {
+  int fd = mkstemp(&temp[0]);
+  if (fd == -1) {
     fprintf (stderr, "Cannot create temporary file '%s'", temp);
     abort ();
     return -1;
   }
   
+  //Only the name is needed, the generated script writes the file.
+  close (fd);
+  
   if (size < strlen (temp)) {
     return -1;
   }
@@ -48,9 +57,146 @@ int getProjectionTempFile (char* file, size_t size)
   return 0;
 }
 
+//Projection code is kept escaped for a double quoted shell string, this
+//returns the string the shell would pass on.
+std::string unescapeShellString (const std::string& str)
+{
+  std::string result;
+  
+  for (size_t i = 0; i < str.size (); i++) {
+    if (str[i] == '\\' && i + 1 < str.size () && strchr ("\"\\$`", str[i + 1])) {
+      i++;
+    }
+    result += str[i];
+  }
+  
+  return result;
+}
+
+//Quotes and escapes str as a JSON string.
+std::string jsonString (const std::string& str)
+{
+  std::string result = "\"";
+  
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      case '\n':
+        result += "\\n";
+        break;
+      case '\t':
+        result += "\\t";
+        break;
+      default:
+        if ((unsigned char) c < 0x20) {
+          char escaped[8];
+          sprintf (escaped, "\\u%04x", c);
+          result += escaped;
+        } else {
+          result += c;
+        }
+    }
+  }
+  
+  return result + "\"";
+}
+
+//jq code setting path to value. Unlike merging {"saved": {"X": value}}
+//into the document it only touches the objects on the path, and replaces
+//what was there. The value is read from the input of the assignment.
+std::string jqAssignment (const std::string& path, const std::string& value)
+{
+  //Paths and literals bind tighter than =, anything else is parenthesized.
+  if (value.find_first_not_of ("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_.[]\\\"") ==
+      std::string::npos)
+    return path + " = " + value;
+  
+  return path + " = (" + value + ")";
+}
+
+//Reads a string written by jsonString, with is after the opening quote.
+static bool readJSONString (std::istream& is, std::string& str)
+{
+  char c;
+  
+  str.clear ();
+  while (is.get (c)) {
+    if (c == '"')
+      return true;
+    
+    if (c == '\\') {
+      if (!is.get (c))
+        return false;
+      
+      switch (c) {
+        case 'n':
+          c = '\n';
+          break;
+        case 't':
+          c = '\t';
+          break;
+        case 'u': {
+          char hex[5] = {0};
+          
+          if (!is.read (hex, 4))
+            return false;
+          c = (char) strtol (hex, nullptr, 16);
+          break;
+        }
+      }
+    }
+    
+    str += c;
+  }
+  
+  return false;
+}
+
+bool DeploymentState::read (std::istream& is)
+{
+  char c;
+  
+  if (!(is >> c) || c != '{')
+    return false;
+  
+  while (is >> c) {
+    std::string name, hash;
+    
+    if (c == '}')
+      return true;
+    if (c == ',' && !(is >> c))
+      return false;
+    if (c != '"' || !readJSONString (is, name) || !(is >> c) || c != ':' ||
+        !(is >> c) || c != '"' || !readJSONString (is, hash))
+      return false;
+    
+    previous[name] = hash;
+  }
+  
+  return false;
+}
+
+void DeploymentState::write (std::ostream& os)
+{
+  bool first = true;
+  
+  os << "{";
+  for (auto& action : current) {
+    os << (first ? "\n" : ",\n") << "  " << jsonString (action.first) << ": " << jsonString (action.second);
+    first = false;
+  }
+  os << "\n}\n";
+}
+
+static const char alphanum[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
 std::string gen_random_str(const int len)
 {
-  static const char alphanum[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
   std::string str = "";
     
   for (int i = 0; i < len; ++i) {
@@ -60,37 +206,63 @@ std::string gen_random_str(const int len)
   return str;
 }
 
-static std::unordered_map <std::string, Identifier*> identifiers; // <id>_<version> to Identifier*
-Identifier* createNewIdentifier (std::string id, int version)
+//FNV-1a, continuing from hash so that several strings can be combined.
+uint64_t fnvHash (const std::string& str, uint64_t hash)
 {
-  std::string to_search = id+"_"+std::to_string(version);
-  if (identifiers.find (to_search) == identifiers.end ()) {
-    identifiers[to_search] = new Identifier(id, version);
+  for (unsigned char c : str) {
+    hash ^= c;
+    hash *= FNV_PRIME;
   }
   
-  return identifiers[to_search];
+  return hash;
 }
 
-int latestVersion (std::string id, VersionMap& versionMap)
+//Like gen_random_str but the characters are taken from hash, so the same
+//content always gets the same name. FNV-1a leaves the high bits of hashes
+//of similar strings equal, mix them in first.
+std::string gen_hash_str (uint64_t hash, const int len)
 {
-  if (versionMap.find (id) == versionMap.end ()) {
-    versionMap [id] = 0;
+  std::string str = "";
+  
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  
+  for (int i = 0; i < len; ++i) {
+    str += alphanum[hash % (sizeof(alphanum) - 1)];
+    hash /= sizeof(alphanum) - 1;
   }
   
-  return versionMap[id];
+  return str;
+}
+
+std::string gen_hash_str (const std::string& content, const int len)
+{
+  return gen_hash_str (fnvHash (content), len);
+}
+
+static std::unordered_map <VersionedSymbol, Identifier*> identifiers;
+Identifier* createNewIdentifier (Symbol id, int version)
+{
+  Identifier*& identifier = identifiers[makeVersionedSymbol (id, version)];
+  
+  if (identifier == nullptr) {
+    identifier = arenaNew<Identifier> (id, version);
+  }
+  
+  return identifier;
 }
 
-Identifier* identifierForVersion (std::string id, VersionMap& versionMap)
+int latestVersion (Symbol id, VersionMap& versionMap)
 {
   if (versionMap.find (id) == versionMap.end ()) {
     versionMap [id] = 0;
   }
   
-  return createNewIdentifier (id, versionMap[id]);
+  return versionMap[id];
 }
 
-int updateVersionNumber (std::string id, VersionMap& versionMap, 
-                         VersionMap& bbVersionMap)
+int updateVersionNumber (Symbol id, VersionMap& versionMap)
 {
   if (versionMap.find (id) == versionMap.end ()) {
     versionMap [id] = 0;
@@ -98,407 +270,348 @@ int updateVersionNumber (std::string id, VersionMap& versionMap,
     versionMap [id] += 1;
   }
   
-  bbVersionMap[id] = versionMap[id];
-  
   return versionMap[id];
 }
 
-void allPredsDefiningID (BasicBlock* currBasicBlock, Identifier* id,
-                         BasicBlockVersionMap& bbVersionMap, 
-                         PHINodePair& phiPair, 
-                         std::unordered_set<BasicBlock*>& visited)
+//Identifiers read by instr and the Identifier it defines (or nullptr).
+//PHI operands are not uses here, they are read on the incoming edges.
+void getUsesAndDef (Instruction* instr, std::vector<Identifier*>& uses,
+                    Identifier*& def)
 {
-  if (visited.count (currBasicBlock) != 0) {
-    return;
-  }
+  GetAllInputIdentifierVisitor idsVisitor;
   
-  auto preds = currBasicBlock->getPredecessors();
-  visited.insert (currBasicBlock);
-  for (auto pred : preds) {
-    if (visited.count (pred) == 0 and 
-        bbVersionMap[pred].find (id->getID()) != bbVersionMap[pred].end ()) {
-      Identifier* newID = identifierForVersion (id->getID(), bbVersionMap[pred]);
-      phiPair[id].push_back (std::make_pair (pred, newID));
-    } else {
-      allPredsDefiningID (pred, id, bbVersionMap, phiPair, visited);      
+  def = nullptr;
+  switch (instr->getKind ()) {
+    case IRNode::CallKind: {
+      Call* call = cast <Call> (instr);
+      
+      uses = idsVisitor.getAllInputIds (call->getArgument ());
+      def = call->getReturnValue ();
+      break;
+    }
+    case IRNode::AssignmentKind: {
+      Assignment* assign = cast <Assignment> (instr);
+      
+      uses = idsVisitor.getAllInputIds (assign->getInput ());
+      def = assign->getOutput ();
+      break;
     }
+    case IRNode::ConditionalBranchKind:
+      uses = idsVisitor.getAllInputIds (cast <ConditionalBranch> (instr)->getCondition ());
+      break;
+    case IRNode::StorePointerKind:
+      uses = idsVisitor.getAllInputIds (cast <StorePointer> (instr)->getInputExpr ());
+      break;
+    case IRNode::ReturnKind:
+      uses = idsVisitor.getAllInputIds (cast <Return> (instr)->getReturnExpr ());
+      break;
+    case IRNode::LoadPointerKind:
+      def = cast <LoadPointer> (instr)->getRetVal ();
+      break;
+    case IRNode::PHIKind:
+      def = cast <PHI> (instr)->getOutput ();
+      break;
+    case IRNode::DirectBranchKind:
+    case IRNode::BackwardBranchKind:
+      break;
+    default:
+      fprintf (stderr, "Type '%s' not implemented\n", typeid (*instr).name());
+      abort ();
   }
 }
 
-void updateVersionNumberInSSA (IRNode* irNode, BasicBlock* basicBlock, 
-                               VersionMap& idVersions, 
-                               BasicBlockVersionMap& bbVersionMap,
-                               PHINodePair& phiNodePair)
+struct SSABlockInfo
+{
+  std::unordered_set <Symbol> upwardExposedUses;
+  std::unordered_set <Symbol> defs;
+  std::unordered_set <Symbol> liveIn;
+};
+
+typedef std::unordered_map <BasicBlock*, SSABlockInfo> SSABlockInfoMap;
+
+//Backward liveness of the variable names over the reachable blocks. Used
+//to prune PHIs of variables which are dead at the join.
+void computeLiveIn (DominatorTree& domTree, SSABlockInfoMap& blockInfo,
+                    std::vector<Symbol>& definedVars)
 {
-  if (dynamic_cast <Identifier*> (irNode) != nullptr) {
-    Identifier* id;
-    PHINodePair phiNodePairForID;
-    std::unordered_set <BasicBlock*> visited;
-    id = (Identifier*) (irNode);
-    allPredsDefiningID (basicBlock, id, bbVersionMap, phiNodePairForID,
-                        visited);
+  std::unordered_set <Symbol> seenDefs;
+  
+  for (auto bb : domTree.getReversePostOrder ()) {
+    SSABlockInfo& info = blockInfo[bb];
     
-    if (phiNodePairForID.size () > 0) {
-      for (auto iter : phiNodePairForID) {
-        if (iter.second.size () >= 2) {
-          updateVersionNumber (iter.first->getID (), idVersions, 
-                              bbVersionMap[basicBlock]);
-          phiNodePair[iter.first] = iter.second; 
-        }
+    for (auto instr : bb->getInstructions ()) {
+      std::vector<Identifier*> uses;
+      Identifier* def;
+      
+      getUsesAndDef (instr, uses, def);
+      for (auto use : uses) {
+        if (info.defs.count (use->getSymbol ()) == 0)
+          info.upwardExposedUses.insert (use->getSymbol ());
+      }
+      
+      if (def != nullptr) {
+        info.defs.insert (def->getSymbol ());
+        if (seenDefs.insert (def->getSymbol ()).second)
+          definedVars.push_back (def->getSymbol ());
       }
     }
-    
-    id->setVersion (latestVersion (id->getID (), idVersions));
-  } else if (dynamic_cast <PatternApplication*> (irNode) != nullptr) {
-    PatternApplication* patapp = (PatternApplication*) irNode;
-    
-    updateVersionNumberInSSA (patapp->getIdentifier (), basicBlock, idVersions,
-                              bbVersionMap, phiNodePair);
-  } else if (dynamic_cast <JSONObject*> (irNode) != nullptr) {
-    JSONObject* obj;
-    
-    obj = (JSONObject*) irNode;
-    for (auto kvpair : obj->getKeyValuePairs ()) {
-      updateVersionNumberInSSA (kvpair, basicBlock, idVersions,
-                              bbVersionMap, phiNodePair);
+  }
+  
+  //Postorder visits successors first, acyclic programs converge in one
+  //pass plus the check.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    auto& rpo = domTree.getReversePostOrder ();
+    for (auto iter = rpo.rbegin (); iter != rpo.rend (); ++iter) {
+      SSABlockInfo& info = blockInfo[*iter];
+      size_t oldSize = info.liveIn.size ();
+      
+      info.liveIn.insert (info.upwardExposedUses.begin (), 
+                          info.upwardExposedUses.end ());
+      for (auto succ : (*iter)->getSuccessors ()) {
+        if (!domTree.isReachable (succ))
+          continue;
+        for (auto var : blockInfo[succ].liveIn) {
+          if (info.defs.count (var) == 0)
+            info.liveIn.insert (var);
+        }
+      }
+      
+      if (info.liveIn.size () != oldSize)
+        changed = true;
     }
-    
-  } else if (dynamic_cast <JSONKeyValuePair*> (irNode) != nullptr) {
-    JSONKeyValuePair* kvpair;
-    
-    kvpair = (JSONKeyValuePair*) irNode;
-    updateVersionNumberInSSA (kvpair->getValue (), basicBlock, idVersions,
-                              bbVersionMap, phiNodePair);
-  } else if (dynamic_cast <Conditional*> (irNode) != nullptr) {
-    Conditional* cond;
-    
-    cond = (Conditional*) irNode;
-    updateVersionNumberInSSA (cond->getOp1 (), basicBlock, idVersions,
-                              bbVersionMap, phiNodePair);
-    updateVersionNumberInSSA (cond->getOp2 (), basicBlock, idVersions,
-                              bbVersionMap, phiNodePair);
-  } else if (dynamic_cast <Constant*> (irNode) != nullptr) {
-  } else {
-    std::cout << __FUNCTION__ << " not implemented for " << typeid (*irNode).name() << std::endl;
-    abort ();
   }
 }
 
-void updateVersionNumberInBB (BasicBlock* basicBlock, 
-                              VersionMap& idVersions, 
-                              BasicBlockVersionMap& bbVersionMap)
+//Cytron et al. PHI placement on the iterated dominance frontier of the
+//defining blocks, pruned to the blocks where the variable is live-in.
+void insertPHIs (DominatorTree& domTree, SSABlockInfoMap& blockInfo,
+                 std::vector<Symbol>& definedVars,
+                 std::unordered_map <BasicBlock*, std::vector<PHI*>>& phis)
 {
-  std::queue <BasicBlock*> basicBlockQueue;
-  std::unordered_set <BasicBlock*> visited;
+  std::vector <std::vector<BasicBlock*>> defBlocks (SymbolTable::size ());
   
-  basicBlockQueue.push (basicBlock);
-  while (basicBlockQueue.empty () == false) {
-    std::vector<Instruction*> instsToPrepend;
-    basicBlock = basicBlockQueue.front ();
-    basicBlockQueue.pop ();
-    
-    if (visited.count (basicBlock) == 1) {
-      continue;
+  for (auto bb : domTree.getReversePostOrder ()) {
+    for (auto var : blockInfo[bb].defs) {
+      defBlocks[var].push_back (bb);
     }
+  }
+  
+  for (auto var : definedVars) {
+    std::unordered_set <BasicBlock*> hasPHI;
+    std::unordered_set <BasicBlock*> everOnWorklist;
+    std::vector<BasicBlock*> worklist = defBlocks[var];
     
-    visited.insert (basicBlock);
-    //std::cout << "updateVersionNumber: basicBlock " << basicBlock->getBasicBlockName () << std::endl;
-    for (auto instr : basicBlock->getInstructions ()) {
-      PHINodePair phiNodePair;
-      if (dynamic_cast <Call*> (instr) != nullptr) {
-        Call* call;
-        Identifier* arg;
-        Identifier* retVal;
+    everOnWorklist.insert (worklist.begin (), worklist.end ());
+    while (worklist.empty () == false) {
+      BasicBlock* bb = worklist.back ();
+      worklist.pop_back ();
+      
+      for (auto join : domTree.getDominanceFrontier (bb)) {
+        if (hasPHI.count (join) == 1 || blockInfo[join].liveIn.count (var) == 0)
+          continue;
         
-        call = dynamic_cast <Call*> (instr);
-        arg = dynamic_cast<Identifier*> (call->getArgument ());
-        retVal = call->getReturnValue ();
-        updateVersionNumberInSSA (call->getArgument (), basicBlock, 
-                                  idVersions, bbVersionMap, phiNodePair);
-        if (phiNodePair.size () > 0) {
-          for (auto iter : phiNodePair) {
-            if (iter.second.size () > 1) {
-              instsToPrepend.push_back (new PHI (iter.first, iter.second));
-            }
-          }
+        std::vector<std::pair<BasicBlock*, Identifier*>> incoming;
+        for (auto pred : join->getPredecessors ()) {
+          if (domTree.isReachable (pred))
+            incoming.push_back (std::make_pair (pred, (Identifier*)nullptr));
         }
         
-        retVal->setVersion (updateVersionNumber (retVal->getID (), 
-                                                 idVersions, 
-                                                 bbVersionMap[basicBlock]));
-      } else if (dynamic_cast <ConditionalBranch*> (instr) != nullptr) {
-        ConditionalBranch* condBr;
-        
-        condBr = dynamic_cast <ConditionalBranch*> (instr);
-        updateVersionNumberInSSA (condBr->getCondition (), basicBlock,
-                                  idVersions, bbVersionMap, phiNodePair);
-        if (phiNodePair.size () > 0) {
-          for (auto iter : phiNodePair) {
-            if (iter.second.size () > 1) {
-              instsToPrepend.push_back (new PHI (iter.first, iter.second));
-            }
-          }
-        }
+        phis[join].push_back (arenaNew<PHI> (arenaNew<Identifier> (var), incoming));
+        hasPHI.insert (join);
+        if (everOnWorklist.insert (join).second)
+          worklist.push_back (join);
+      }
+    }
+  }
+  
+  for (auto& iter : phis) {
+    for (auto phi = iter.second.rbegin (); phi != iter.second.rend (); ++phi) {
+      iter.first->prependInstruction (*phi);
+    }
+  }
+}
 
-        basicBlockQueue.push (condBr->getThenBranch ());
-        basicBlockQueue.push (condBr->getElseBranch ());
-        
-        //assert (*condBr->getThenBranch ()->getSuccessors().begin () ==
-        //        *condBr->getElseBranch ()->getSuccessors().begin ());
-        //~ updateVersionNumberInBB (*condBr->getThenBranch ()->getSuccessors().begin (),
-                                 //~ idVersions, bbVersionMap);
-      } else if (dynamic_cast <DirectBranch*> (instr) != nullptr) {
-        DirectBranch* branch;
-        
-        branch = (DirectBranch*) (instr);
-        basicBlockQueue.push (branch->getTarget ());
-      } else if (dynamic_cast <Assignment*> (instr) != nullptr) {
-        Assignment* assign;
-        
-        assign = (Assignment*) instr;
-        updateVersionNumberInSSA (assign->getOutput (), basicBlock, 
-                                  idVersions, bbVersionMap, phiNodePair);
-        updateVersionNumberInSSA (assign->getInput (), basicBlock, 
-                                  idVersions, bbVersionMap, phiNodePair);
-      } else if (dynamic_cast <StorePointer*> (instr) != nullptr) {
-        StorePointer* str;
+int currentVersion (Symbol id, std::vector <std::vector<int>>& stacks,
+                    VersionMap& idVersions)
+{
+  if (stacks[id].empty () == false)
+    return stacks[id].back ();
+  
+  //Not defined on this path (like input)
+  return latestVersion (id, idVersions);
+}
+
+//Renames all uses and defs by walking the dominator tree, every def gets
+//a fresh version and every use the version of the nearest dominating def.
+void renameVariables (DominatorTree& domTree, VersionMap& idVersions,
+                      std::unordered_map <BasicBlock*, std::vector<PHI*>>& phis)
+{
+  struct Frame
+  {
+    BasicBlock* bb;
+    size_t nextChild;
+    std::vector<Symbol> pushed;
+  };
+  
+  std::vector <std::vector<int>> stacks (SymbolTable::size ());
+  std::vector<Frame> frames;
+  
+  frames.push_back (Frame {domTree.getEntry (), 0, {}});
+  while (frames.empty () == false) {
+    Frame& frame = frames.back ();
+    BasicBlock* bb = frame.bb;
+    
+    if (frame.nextChild == 0) {
+      for (auto instr : bb->getInstructions ()) {
+        std::vector<Identifier*> uses;
+        Identifier* def;
         
-        str = (StorePointer*) instr;
-        updateVersionNumberInSSA (((Identifier*)str->getInputExpr ()), basicBlock, idVersions, bbVersionMap, phiNodePair);
-      } else if (dynamic_cast <LoadPointer*> (instr) != nullptr) {
-        LoadPointer* ld;
+        getUsesAndDef (instr, uses, def);
+        for (auto use : uses) {
+          use->setVersion (currentVersion (use->getSymbol (), stacks, idVersions));
+        }
         
-        ld = (LoadPointer*) instr;
-        ld->getRetVal ()->setVersion (updateVersionNumber (((Identifier*)ld->getRetVal ())->getID (),
-                                  idVersions, bbVersionMap[basicBlock]));
-      } else if (dynamic_cast <Return*> (instr) != nullptr) {
-        updateVersionNumberInSSA (((Return*)instr)->getReturnExpr (), basicBlock, idVersions, bbVersionMap, phiNodePair);
-      } else {
-        fprintf (stderr, "Type '%s' not implemented\n", typeid (*instr).name());
-        abort ();
+        if (def != nullptr) {
+          def->setVersion (updateVersionNumber (def->getSymbol (), idVersions));
+          stacks[def->getSymbol ()].push_back (def->getVersion ());
+          frame.pushed.push_back (def->getSymbol ());
+        }
+      }
+      
+      for (auto succ : bb->getSuccessors ()) {
+        for (auto phi : phis[succ]) {
+          Symbol id = phi->getOutput ()->getSymbol ();
+          phi->setIncoming (bb, createNewIdentifier (id, currentVersion (id, stacks, idVersions)));
+        }
       }
     }
     
-    for (auto instr: instsToPrepend) {
-      basicBlock->prependInstruction (instr);
+    const std::vector<BasicBlock*>& children = domTree.getChildren (bb);
+    if (frame.nextChild < children.size ()) {
+      BasicBlock* child = children[frame.nextChild++];
+      frames.push_back (Frame {child, 0, {}});
+      continue;
+    }
+    
+    for (auto id : frame.pushed) {
+      stacks[id].pop_back ();
     }
+    frames.pop_back ();
   }
 }
 
-IRNode* convertToSSAIR (ASTNode* astNode, BasicBlock* currBasicBlock,
-                        VersionMap& idVersions, 
-                        BasicBlockVersionMap& bbVersionMap);
-                        
-//Takes a JSONExpression Exp, adds a statement like temp = Exp, and
-//returns temp
-Identifier* convertInputToSSAIR (JSONExpression* astNode, BasicBlock* currBasicBlock,
-                                 VersionMap& idVersions, 
-                                 BasicBlockVersionMap& bbVersionMap)
+//Pruned SSA construction: dominator tree and frontiers, PHIs only where the
+//variable is live-in, then renaming along the dominator tree.
+void buildSSA (BasicBlock* firstBasicBlock, VersionMap& idVersions)
 {
-  if (dynamic_cast <JSONIdentifier*> (astNode) != nullptr) {
-    IRNode* to_ret = convertToSSAIR (astNode, currBasicBlock, idVersions, 
-                                     bbVersionMap);
-    assert (dynamic_cast<Identifier*> (to_ret) != nullptr);
-    return (Identifier*)to_ret;
-  }
+  DominatorTree domTree (firstBasicBlock);
+  SSABlockInfoMap blockInfo;
+  std::vector<Symbol> definedVars;
+  std::unordered_map <BasicBlock*, std::vector<PHI*>> phis;
   
-  IRNode* exp = convertToSSAIR (astNode, currBasicBlock, idVersions, bbVersionMap);
-  assert (dynamic_cast<Expression*> (exp) != nullptr);
-  static int tempVersion = 0;
-  Identifier* out = new Identifier ("temp"+std::to_string(tempVersion++), 0, nullptr);
-  currBasicBlock->appendInstruction (new Assignment (out, dynamic_cast<Expression*> (exp)));
-  
-  return out;
+  computeLiveIn (domTree, blockInfo, definedVars);
+  insertPHIs (domTree, blockInfo, definedVars, phis);
+  renameVariables (domTree, idVersions, phis);
 }
 
 IRNode* convertToSSAIR (ASTNode* astNode, BasicBlock* currBasicBlock,
-                        VersionMap& idVersions, 
-                        BasicBlockVersionMap& bbVersionMap)
-{
-  if (dynamic_cast <JSONIdentifier*> (astNode) != nullptr) {
-    JSONIdentifier* jsonId;
-    
-    jsonId = dynamic_cast <JSONIdentifier*> (astNode);
-    if (true or idVersions.count (jsonId->getIdentifier ()) == 0) {
-      //return createNewIdentifier (identifierForVersion (jsonId->getIdentifier (), idVersions));
-      auto to_ret = new Identifier (jsonId->getIdentifier ());
-      currBasicBlock->insertRead (to_ret);
-      return to_ret;
-    } else {
-      //~ PHINodePair phiPair;
-      //~ std::string id = jsonId->getIdentifier ();
-      //~ allPredsDefiningID (currBasicBlock, createNewIdentifier(id), bbVersionMap, phiPair);
-      //~ if (phiPair.size () > 0) {
-        //~ id = updateVersionNumber (id, idVersions, bbVersionMap[currBasicBlock]);
-        //~ Identifier* newId = createNewIdentifier (id);
-        //~ std::cout << "newInputID " << newId << std::endl;
-        //~ for (auto iter : phiPair) {
-          //~ std::cout << "iter.first = " << iter.first << std::endl;
-          //~ currBasicBlock->appendInstruction (new PHI (newId, iter.second));
-        //~ }
-        
-        //~ return newId;
-        //~ for (auto iter : phiPair) {
-          //~ std::cout << iter.first << std::endl;
-          //~ for (auto vecIter : iter.second) {
-            //~ std::cout << vecIter.first << " " << vecIter.second->getID () << std::endl;
-          //~ }
-        //~ }
-      //~ } else {
-        //~ return createNewIdentifier (identifierForVersion (jsonId->getIdentifier (), idVersions));
-      //~ }
-    }
-  } else if (dynamic_cast <CallAction*> (astNode) != nullptr) {
-    CallAction* callAction;
-    std::string newOutputID;
-    Identifier* newOutput;
-    Identifier* newInput;
-    std::string newInputID;
-    std::string inputID;
-    PHINodePair phiPair;
-    JSONIdentifier* input;
-    
-    callAction = dynamic_cast <CallAction*> (astNode);
-    input = ((JSONIdentifier*)callAction->getArgument ());
-
-    if (dynamic_cast <JSONInput*> (input) != nullptr) {
-      //There can only be one Input
-      newInput = new Input ();
-    } else {
-      inputID = input->getIdentifier ();
-    
-      //~ allPredsDefiningID (currBasicBlock, createNewIdentifier(inputID), bbVersionMap, phiPair);
-      if (false and phiPair.size () > 0) {
-        //~ newInputID = updateVersionNumber (inputID, idVersions, bbVersionMap[currBasicBlock]);
-        //~ newInput = createNewIdentifier (newInputID);
-        //~ std::cout << "newInputID " << newInputID << std::endl;
-        //~ for (auto iter : phiPair) {
-          //~ std::cout << "iter.first = " << iter.first << std::endl;
-          //~ currBasicBlock->appendInstruction (new PHI (newInput, iter.second));
-        //~ }
-        
-        //~ for (auto iter : phiPair) {
-          //~ std::cout << iter.first << std::endl;
-          //~ for (auto vecIter : iter.second) {
-            //~ std::cout << vecIter.first << " " << vecIter.second->getID () << std::endl;
-          //~ }
-        //~ }
-      } else {
-        //newInputID = identifierForVersion (inputID, idVersions);
-        newInput = (Identifier*)convertToSSAIR (input, currBasicBlock, idVersions, 
-                                                bbVersionMap);
-      }
-    }
-    
-    newOutput = new Identifier (callAction->getReturnValue()->getIdentifier ());
-    currBasicBlock->insertWrite (newOutput);
-    //~ updateVersionNumber (,
-                                       //~ idVersions, 
-                                       //~ bbVersionMap[currBasicBlock]);
-    
-    //std::cout << newOutputID << " " <<  callAction->getActionName () << " " << newInputID << std::endl;
-    return new Call (newOutput, callAction->getActionName (),
-                     newInput);
-                     //TODO: (Expression*)convertToSSAIR (callAction->getArgument ()));
-  } /*else if (dynamic_cast <JSONTransformation*> (astNode) != nullptr) {
-    JSONTransformation* trans;
-    PatternApplication* patapp;
-    
-    trans = dynamic_cast <JSONTransformation*> (astNode);
-    IRNode* in = convertToSSAIR (trans->getInput (), currBasicBlock, idVersions, bbVersionMap);
-    IRNode* pat = convertToSSAIR (trans->getTransformation (), currBasicBlock, idVersions, bbVersionMap);
-    IRNode* out = convertToSSAIR (trans->getOutput (), currBasicBlock, idVersions, bbVersionMap);
-    assert (dynamic_cast<Pattern*> (pat) != nullptr);
-    assert (dynamic_cast<Identifier*> (in) != nullptr);
-    assert (dynamic_cast<Identifier*> (out) != nullptr);
-    
-    patapp = new PatternApplication ((Identifier*)in, (Pattern*)pat);    
-    return new Assignment ((Identifier*) out, patapp);
-  } */else if (dynamic_cast <LetCommand*> (astNode) != nullptr) {
-    abort ();
-  } else if (dynamic_cast <NumberExpression*> (astNode) != nullptr) {
-      return new Number ((dynamic_cast <NumberExpression*> (astNode))->getNumber ());
-  } else if (dynamic_cast <StringExpression*> (astNode) != nullptr) {
-    return new String ((dynamic_cast <StringExpression*> (astNode))->getString ());
-  } else if (dynamic_cast <BooleanExpression*> (astNode) != nullptr) {
-    return new Boolean ((dynamic_cast <BooleanExpression*> (astNode))->getBoolean ());
-  } else if (dynamic_cast <JSONArrayExpression*> (astNode) != nullptr) {
-  } else if (dynamic_cast <KeyValuePair*> (astNode) != nullptr) {
-    KeyValuePair* kv = dynamic_cast <KeyValuePair*> (astNode);
-    //TODO: call convertInputToSSAIR?
-    IRNode* node = convertToSSAIR (kv->getValue (), currBasicBlock, idVersions, bbVersionMap);
-    assert (dynamic_cast <JSONKeyValuePair*> (node) != nullptr);
-    return new JSONKeyValuePair (kv->getKey (), (Expression*)node);
-  } else if (dynamic_cast <JSONObjectExpression*> (astNode) != nullptr) {
-    std::vector<JSONKeyValuePair*> jsonkvpairs;
-    JSONObjectExpression* e = (JSONObjectExpression*) (astNode);
-    for (KeyValuePair* kv : e->getKVPairs ()) {
-      //TODO: call convertInputToSSAIR?
-      IRNode* node = convertToSSAIR (kv, currBasicBlock, idVersions, bbVersionMap);
-      assert (dynamic_cast <JSONKeyValuePair*> (node) != nullptr);
-      jsonkvpairs.push_back ((JSONKeyValuePair*)node);
-    }
-    
-    return new JSONObject (jsonkvpairs);
-  } else if (dynamic_cast <JSONInput*> (astNode) != nullptr) {
-    return new Input ();
-  } else if (dynamic_cast <JSONPatternApplication*> (astNode) != nullptr) {
-    JSONPatternApplication* patapp = (JSONPatternApplication*) astNode;
-    fprintf (stderr, "patapp pat '%s'\n", typeid(*patapp->getPattern ()).name());
-    
-    IRNode* exp = convertToSSAIR (patapp->getExpression (), 
-                                       currBasicBlock, idVersions, 
-                                       bbVersionMap);
-    IRNode* pat = convertToSSAIR (patapp->getPattern (), currBasicBlock, idVersions, bbVersionMap);
-    assert (dynamic_cast <Pattern*> (pat) != nullptr);
-    assert (dynamic_cast <Expression*> (exp) != nullptr);
-    return new PatternApplication ((Expression*)exp, (Pattern*)pat);
-  } else if (dynamic_cast <FieldGetJSONPattern*> (astNode) != nullptr) {
-    FieldGetJSONPattern* pat = (FieldGetJSONPattern*)astNode;
-    return new FieldGetPattern (pat->getFieldName ());
-  } else if (dynamic_cast <ArrayIndexJSONPattern*> (astNode) != nullptr) {
-    ArrayIndexJSONPattern* pat = (ArrayIndexJSONPattern*) astNode;
-    return new ArrayIndexPattern (pat->getIndex ());
-  } else if (dynamic_cast <KeyGetJSONPattern*> (astNode) != nullptr) {
-    KeyGetJSONPattern* pat = (KeyGetJSONPattern*) astNode;
-    return new KeyGetPattern (pat->getKeyName ());
-  } else if (dynamic_cast <JSONAssignment*> (astNode) != nullptr) {
-    JSONAssignment* assign;
-    
-    assign = (JSONAssignment*)astNode;
-    IRNode* out = convertToSSAIR (assign->getOutput (), currBasicBlock, 
-                                  idVersions, bbVersionMap);
-    IRNode* exp = convertInputToSSAIR (assign->getInput (), currBasicBlock,
-                                       idVersions, bbVersionMap);
-    assert (dynamic_cast <Identifier*> (out) != nullptr);
-    assert (dynamic_cast <Expression*> (exp) != nullptr);
-    return new Assignment ((Identifier*)out, (Expression*)exp);
-  } else if (dynamic_cast <JSONConditional*> (astNode) != nullptr) {
-    JSONConditional* cond;
-    IRNode* op1, *op2;
-    
-    cond = (JSONConditional*) astNode;
-    op1 = convertInputToSSAIR (cond->getOp1 (), currBasicBlock, idVersions, 
-                               bbVersionMap); 
-    op2 = convertInputToSSAIR (cond->getOp2 (), currBasicBlock, idVersions, 
-                               bbVersionMap);
-    assert (dynamic_cast <Expression*> (op1) != nullptr);
-    assert (dynamic_cast <Expression*> (op2) != nullptr);
-    
-    return new Conditional ((Expression*)op1, cond->getOperator (), 
-                            (Expression*)op2);
-  } else if (dynamic_cast <ReturnJSON*> (astNode) != nullptr) {
-    ReturnJSON* returnStmt;
-    
-    returnStmt = (ReturnJSON*)astNode;
-    IRNode* exp = convertInputToSSAIR (returnStmt->getReturnExpr (),
-                                       currBasicBlock, idVersions,
-                                       bbVersionMap);
-    assert (dynamic_cast <Identifier*> (exp) != nullptr);
-    return new Return ((Identifier*)exp);
-  } else {
-    fprintf (stderr, "Invalid AstNode type '%s'\n", typeid(*astNode).name());
-    abort ();
+                        VersionMap& idVersions);
+                        
+IRNode* convertToSSAIR (ASTNode* astNode, BasicBlock* currBasicBlock,
+                        VersionMap& idVersions)
+{
+  switch (astNode->getKind ()) {
+    case ASTNode::JSONIdentifierKind: {
+      JSONIdentifier* jsonId;
+      
+      jsonId = cast <JSONIdentifier> (astNode);
+      return arenaNew<Identifier> (jsonId->getIdentifier ());
+    }
+    case ASTNode::CallActionKind: {
+      CallAction* callAction;
+      Identifier* newOutput;
+      IRNode* newInput;
+      
+      callAction = cast <CallAction> (astNode);
+      newInput = convertToSSAIR (callAction->getArgument (), currBasicBlock, idVersions);
+      newOutput = arenaNew<Identifier> (callAction->getReturnValue()->getIdentifier ());
+      
+      return arenaNew<Call> (newOutput, callAction->getActionName (),
+                             cast <Expression> (newInput));
+    }
+    case ASTNode::LetCommandKind:
+      abort ();
+    case ASTNode::NumberExpressionKind:
+      return arenaNew<Number> (cast <NumberExpression> (astNode)->getNumber ());
+    case ASTNode::StringExpressionKind:
+      return arenaNew<String> (cast <StringExpression> (astNode)->getString ());
+    case ASTNode::BooleanExpressionKind:
+      return arenaNew<Boolean> (cast <BooleanExpression> (astNode)->getBoolean ());
+    case ASTNode::KeyValuePairKind: {
+      KeyValuePair* kv = cast <KeyValuePair> (astNode);
+      IRNode* node = convertToSSAIR (kv->getValue (), currBasicBlock, idVersions);
+      return arenaNew<JSONKeyValuePair> (kv->getKey (), cast <Expression> (node));
+    }
+    case ASTNode::JSONObjectExpressionKind: {
+      std::vector<JSONKeyValuePair*> jsonkvpairs;
+      JSONObjectExpression* e = cast <JSONObjectExpression> (astNode);
+      for (KeyValuePair* kv : e->getKVPairs ()) {
+        IRNode* node = convertToSSAIR (kv, currBasicBlock, idVersions);
+        jsonkvpairs.push_back (cast <JSONKeyValuePair> (node));
+      }
+      
+      return arenaNew<JSONObject> (jsonkvpairs);
+    }
+    case ASTNode::JSONInputKind:
+      return arenaNew<Input> ();
+    case ASTNode::JSONPatternApplicationKind: {
+      JSONPatternApplication* patapp = cast <JSONPatternApplication> (astNode);
+      
+      IRNode* exp = convertToSSAIR (patapp->getExpression (), 
+                                    currBasicBlock, idVersions);
+      IRNode* pat = convertToSSAIR (patapp->getPattern (), currBasicBlock, idVersions);
+      return arenaNew<PatternApplication> (cast <Expression> (exp), cast <Pattern> (pat));
+    }
+    case ASTNode::FieldGetJSONPatternKind:
+      return arenaNew<FieldGetPattern> (cast <FieldGetJSONPattern> (astNode)->getFieldName ());
+    case ASTNode::ArrayIndexJSONPatternKind:
+      return arenaNew<ArrayIndexPattern> (cast <ArrayIndexJSONPattern> (astNode)->getIndex ());
+    case ASTNode::KeyGetJSONPatternKind:
+      return arenaNew<KeyGetPattern> (cast <KeyGetJSONPattern> (astNode)->getKeyName ());
+    case ASTNode::JSONAssignmentKind: {
+      JSONAssignment* assign;
+      
+      assign = cast <JSONAssignment> (astNode);
+      IRNode* out = convertToSSAIR (assign->getOutput (), currBasicBlock, 
+                                    idVersions);
+      IRNode* exp = convertToSSAIR (assign->getInput (), currBasicBlock,
+                                    idVersions);
+      return arenaNew<Assignment> (cast <Identifier> (out), cast <Expression> (exp));
+    }
+    case ASTNode::JSONConditionalKind: {
+      JSONConditional* cond;
+      IRNode* op1, *op2;
+      
+      cond = cast <JSONConditional> (astNode);
+      op1 = convertToSSAIR (cond->getOp1 (), currBasicBlock, idVersions); 
+      op2 = convertToSSAIR (cond->getOp2 (), currBasicBlock, idVersions);
+      
+      return arenaNew<Conditional> (cast <Expression> (op1), cond->getOperator (),
+                                    cast <Expression> (op2));
+    }
+    case ASTNode::ReturnJSONKind: {
+      ReturnJSON* returnStmt;
+      
+      returnStmt = cast <ReturnJSON> (astNode);
+      IRNode* exp = convertToSSAIR (returnStmt->getReturnExpr (),
+                                    currBasicBlock, idVersions);
+      return arenaNew<Return> (cast <Expression> (exp));
+    }
+    default:
+      fprintf (stderr, "Invalid AstNode type '%s'\n", typeid(*astNode).name());
+      abort ();
   }
   
   abort ();
@@ -514,70 +627,77 @@ IRNode* convertToSSAIR (ASTNode* astNode, BasicBlock* currBasicBlock,
 BasicBlock* convertToBasicBlock (ComplexCommand* complexCmd, 
                                  std::vector<BasicBlock*>& basicBlocks, 
                                  VersionMap& idVersions,
-                                 BasicBlockVersionMap& bbVersionMap,
                                  BasicBlock** exitBlock)
 {
   //This function takes one ComplexCommand containing all other
   //simple commands.
   
   //First convert ComplexCommand to a set of Basic Blocks connected
-  //by branches. Also inserts Phi Branches. 
-  //Algorithm to insert Phi Branches:
-  //1. Every block stores what are the identifiers it has and their
-  // latest version number
-  //2. Get the Identifier for which to look for previous accesses.
-  //3. Go through all the previous basic blocks of current basic block.
-  //4. If a basic block along one path has that identifier then return its
-  //   latest version number.
-  //Above algorithm is naive and may lead to O(N^2) complexity. We 
-  //can use dominators based minimal SSA.
-  
-  BasicBlock* firstBasicBlock = new BasicBlock ();
+  //by branches. Identifiers are left unversioned, buildSSA places the
+  //PHIs and renames them once the whole CFG is known.
+  
+  BasicBlock* firstBasicBlock = arenaNew<BasicBlock> ();
   BasicBlock* currBasicBlock = firstBasicBlock;
   basicBlocks.push_back (firstBasicBlock);
   
   for (auto cmd : complexCmd->getSimpleCommands()) {
-    if (dynamic_cast <IfThenElseCommand*> (cmd) != nullptr) {
+    switch (cmd->getKind ()) {
+    case ASTNode::IfThenElseCommandKind: {
       BasicBlock* thenBasicBlock;
       BasicBlock* elseBasicBlock;
       IfThenElseCommand* ifThenElsecmd;
       ConditionalBranch *condBr;
       IRNode* cond;
       BasicBlock* target;
-      PHINodePair phiPair;
       BasicBlock* exitBlockForThen;
       BasicBlock* exitBlockForElse;
       
       exitBlockForThen = exitBlockForElse = nullptr;
       
-      ifThenElsecmd = dynamic_cast <IfThenElseCommand*> (cmd);
+      ifThenElsecmd = cast<IfThenElseCommand> (cmd);
       thenBasicBlock = convertToBasicBlock (&ifThenElsecmd->getThenBranch (), 
                                             basicBlocks, idVersions, 
-                                            bbVersionMap, &exitBlockForThen);
+                                            &exitBlockForThen);
       elseBasicBlock = convertToBasicBlock (&ifThenElsecmd->getElseBranch (), 
                                             basicBlocks, idVersions, 
-                                            bbVersionMap, &exitBlockForElse);
+                                            &exitBlockForElse);
       cond = convertToSSAIR (ifThenElsecmd->getCondition (), 
-                             currBasicBlock, idVersions, 
-                             bbVersionMap);
-      assert (dynamic_cast <Conditional*> (cond) != nullptr);
-      condBr = new ConditionalBranch ((Conditional*)cond, thenBasicBlock, 
-                                      elseBasicBlock, currBasicBlock);
+                             currBasicBlock, idVersions);
+      condBr = arenaNew<ConditionalBranch> (cast<Conditional> (cond), thenBasicBlock, 
+                                            elseBasicBlock, currBasicBlock);
       currBasicBlock->appendInstruction (condBr);
-      target = new BasicBlock ();
+      target = arenaNew<BasicBlock> ();
       if (exitBlockForThen == nullptr)
         exitBlockForThen = thenBasicBlock;
-      exitBlockForThen->appendInstruction (new DirectBranch (target, exitBlockForThen));
+      exitBlockForThen->appendInstruction (arenaNew<DirectBranch> (target, exitBlockForThen));
       if (exitBlockForElse == nullptr)
         exitBlockForElse = elseBasicBlock;
-      exitBlockForElse->appendInstruction (new DirectBranch (target, exitBlockForElse));
+      exitBlockForElse->appendInstruction (arenaNew<DirectBranch> (target, exitBlockForElse));
       currBasicBlock = target;
       if (exitBlock != nullptr)
         *exitBlock = target;
       basicBlocks.push_back (target);
-    } else if (dynamic_cast <WhileLoop*> (cmd) != nullptr) {
+      break;
+    }
+    case ASTNode::WhileLoopKind: {
+      /* Loops are rotated into a guard and a do-while:
+       *
+       *   curr:     if (cond) goto preheader else goto exit
+       *   preheader: goto body
+       *   body:     ...
+       *   latch:    if (cond) goto body else goto exit
+       *
+       * The latch, the last block of the body, tests the condition again,
+       * so the test is composed with the last projection of the iteration
+       * instead of running in a header block of its own on every iteration.
+       * The preheader is where loop invariant code is hoisted to.
+       * Variables are not kept in pointers across iterations, buildSSA
+       * places a PHI at the start of the body for the ones the loop
+       * changes, like at any other join.
+       */
       WhileLoop* loop;
-      BasicBlock* testBB;
+      BasicBlock* preheader;
+      BasicBlock* latch;
       IRNode* cond;
       BasicBlock* loopBody;
       BasicBlock* loopExit;
@@ -585,113 +705,49 @@ BasicBlock* convertToBasicBlock (ComplexCommand* complexCmd,
       BasicBlock* innerExitBlock;
       
       innerExitBlock = nullptr;
-      loop = dynamic_cast <WhileLoop*> (cmd);
-      testBB = new BasicBlock ();
-      basicBlocks.push_back (testBB);
+      loop = cast<WhileLoop> (cmd);
+      preheader = arenaNew<BasicBlock> ();
+      basicBlocks.push_back (preheader);
       loopBody = convertToBasicBlock (&loop->getBody (), basicBlocks, 
-                                      idVersions, bbVersionMap, 
-                                      &innerExitBlock);
-      
-      //TODO: Make sure that for every load there is a store from every path coming
-      //to this block
-      for (auto iter : loopBody->getReads ()) {
-        LoadPointer* ld; 
-        
-        ld = new LoadPointer (iter.first, new Pointer (iter.first->getID ()));
-        loopBody->insertRead (iter.first, ld);
-        loopBody->prependInstruction (ld);
-        //Add a store for all the loopBody reads in the currBasicBlock
-        StorePointer* str;
-        
-        if (!currBasicBlock->hasWrite (iter.first)) {
-          str = new StorePointer (new Identifier (iter.first->getID ()), 
-                                  new Pointer (iter.first->getID ()));
-          currBasicBlock->insertWrite (iter.first, str);
-          currBasicBlock->appendInstruction (str);
-        }
-      }
-      
-      for (auto iter : loopBody->getWrites ()) {
-        StorePointer* str;
-        
-        if (!loopBody->hasWrite (iter.first)) {
-          str = new StorePointer (iter.first, new Pointer (iter.first->getID ()));
-          loopBody->insertWrite (iter.first, str);
-          loopBody->appendInstruction (str);
-        }
-      }
-      
-      loopExit = new BasicBlock ();
+                                      idVersions, &innerExitBlock);
+      loopExit = arenaNew<BasicBlock> ();
       if (exitBlock != nullptr)
         *exitBlock = loopExit;
       basicBlocks.push_back (loopExit);
       
-      //testBB will have loopBody as one its predecessors
-      if (innerExitBlock != nullptr)
-        innerExitBlock->appendInstruction (new BackwardBranch (testBB, innerExitBlock)); 
-      else
-        loopBody->appendInstruction (new BackwardBranch (testBB, loopBody)); 
-      
-      cond = convertToSSAIR (loop->getCondition (),
-                             testBB, idVersions,
-                             bbVersionMap);
-      assert (dynamic_cast <Conditional*> (cond) != nullptr);
-      for (auto iter : testBB->getReads ()) {
-        LoadPointer* ptr;
-        
-        ptr = new LoadPointer (iter.first, new Pointer (iter.first->getID()));
-        testBB->insertRead (iter.first, ptr);
-        testBB->prependInstruction (ptr);
-        
-        
-        //All the variables used in test condition but not read/write
-        // in/to in loopBody also have to be stored.
-
-        bool found = false;        
-        //TODO: Change this map of reads and writes from Identifier to 
-        //std::string
-        for (auto iter2 : loopBody->getReads()) {
-          if (iter2.first->getID () == iter.first->getID ()) {
-            found = true;
-            break;
-          }
-        }
-        
-        if (not found) {
-          StorePointer* str;
-        
-          str = new StorePointer (new Identifier(iter.first->getID ()), new Pointer (iter.first->getID ()));
-          currBasicBlock->insertWrite (iter.first, str);
-          currBasicBlock->appendInstruction (str);
-        }
-      }
-      
-      //testBB will have currBasicBlock as one of its predecessors
-      currBasicBlock->appendInstruction (new DirectBranch (testBB, 
-                                                           currBasicBlock));
-      
+      //The guard, buildSSA renames the variables of both tests.
+      cond = convertToSSAIR (loop->getCondition (), currBasicBlock, idVersions);
+      assert (isa<Conditional> (cond));
+      condBr = arenaNew<ConditionalBranch> (cast<Conditional> (cond), preheader, loopExit, currBasicBlock);
+      currBasicBlock->appendInstruction (condBr);
+      preheader->appendInstruction (arenaNew<DirectBranch> (loopBody, preheader));
       
-      assert (testBB->getWrites ().size () == 0);
-      condBr = new ConditionalBranch ((Conditional*)cond, loopBody, loopExit, testBB);
-      testBB->appendInstruction (condBr);
+      latch = (innerExitBlock != nullptr) ? innerExitBlock : loopBody;
+      cond = convertToSSAIR (loop->getCondition (), latch, idVersions);
+      condBr = arenaNew<ConditionalBranch> (cast<Conditional> (cond), loopBody, loopExit, latch);
+      latch->appendInstruction (condBr);
       currBasicBlock = loopExit;
-    } else if (dynamic_cast <ReturnJSON*>  (cmd) != nullptr) {
+      break;
+    }
+    case ASTNode::ReturnJSONKind: {
       IRNode* ret;
       
-      ret = convertToSSAIR (cmd, currBasicBlock, idVersions, bbVersionMap);
-      assert (dynamic_cast <Return*> (ret) != nullptr);
-      currBasicBlock->appendInstruction ((Instruction*)ret);
-      currBasicBlock = new BasicBlock ();
+      ret = convertToSSAIR (cmd, currBasicBlock, idVersions);
+      currBasicBlock->appendInstruction (cast<Return> (ret));
+      currBasicBlock = arenaNew<BasicBlock> ();
       basicBlocks.push_back (currBasicBlock);
       if (exitBlock != nullptr)
         *exitBlock = currBasicBlock;
-    } else {
-      PHINodePair phiPair;
+      break;
+    }
+    default: {
       Instruction* ssaInstr;
       
       ssaInstr = (Instruction*)convertToSSAIR (cmd, currBasicBlock, 
-                                               idVersions, bbVersionMap);
+                                               idVersions);
       currBasicBlock->appendInstruction (ssaInstr);
+      break;
+    }
     }
   }
   
@@ -700,16 +756,19 @@ BasicBlock* convertToBasicBlock (ComplexCommand* complexCmd,
   return firstBasicBlock;
 }
 
-Program* convertToSSA (ComplexCommand* cmd, bool print_ssa = false)
+Program* convertToSSA (ComplexCommand* cmd, bool print_ssa)
 {
-  BasicBlockVersionMap bbVersionMap;
   VersionMap idVersions;
   BasicBlock* firstBasicBlock;
   std::vector<BasicBlock*> basicBlocks;
   
-  firstBasicBlock = convertToBasicBlock (cmd, basicBlocks, idVersions, 
-                                         bbVersionMap, nullptr);
-  updateVersionNumberInBB (firstBasicBlock, idVersions, bbVersionMap);
+  //Identifiers of a previous compilation died with its arena.
+  identifiers.clear ();
+  Identifier::resetIdentifiers ();
+  BasicBlock::numberOfBasicBlocks = 0;
+  
+  firstBasicBlock = convertToBasicBlock (cmd, basicBlocks, idVersions, nullptr);
+  buildSSA (firstBasicBlock, idVersions);
   auto it = std::find (basicBlocks.begin(), basicBlocks.end(), firstBasicBlock);
   basicBlocks.erase (it);
   basicBlocks.insert (basicBlocks.begin(), firstBasicBlock);
@@ -719,280 +778,1879 @@ Program* convertToSSA (ComplexCommand* cmd, bool print_ssa = false)
     }
   }
   
-  return new Program (basicBlocks);
+  return arenaNew<Program> (basicBlocks);
 }
 
-void livenessAnalysis (Program* program) 
+//Saved values used and defined by every instruction of a block, the ones
+//used before being defined in the block and the PHI operands flowing in
+//from every predecessor.
+struct BlockUseDef
 {
-  /* Find the last Instruction (s) (and the BasicBlock (s)), where an Identifier
-   * is used. We will emit a projection to delete that identifier from the
-   * saved state.
-   * */
-  //Map of Identifier to BasicBlock to Instruction, where Identifier is used for last time.
-  std::unordered_map <std::string, std::unordered_map <BasicBlock*, Instruction*>>  idToLastDef;
-  std::unordered_set <BasicBlock*> visited;
-  BasicBlock* firstBasicBlock;
-  std::queue <BasicBlock*> queue;
-  BasicBlock dummyFirstBlock;
-  firstBasicBlock = program->getBasicBlocks ()[0];
-  dummyFirstBlock.appendSuccessor (firstBasicBlock);
-  
-  queue.push (&dummyFirstBlock);
-  
-  while (queue.empty () == false) {
-    /* A level search, where for each identifier we determine the basic blocks
-     * (and instructions) where that variable is used. We find the last
-     * instruction in each basic block, where that variable is used.
-     * */
-    BasicBlock* currBlock;
-    std::unordered_map <std::string, std::unordered_map <BasicBlock*, Instruction*>> strToLastDefs;
-    int queueSize = queue.size ();
-    int levelIter = 0;
-    std::queue<BasicBlock*> levelQueue;
-    while (levelIter < queueSize) {
-      currBlock = queue.front ();
-      queue.pop ();
-
-      for (auto block : currBlock->getSuccessors ()) {
-        if (visited.count (block) == 1) 
-          continue;
-        visited.insert (block);
-        levelQueue.push (block);
-        
-        for (auto instrIter = block->getInstructions ().begin ();
-             instrIter != block->getInstructions ().end (); ++instrIter) {
-          
-          Instruction* instr = *instrIter;
-          UseDef useDef;
-          UseDefVisitor visitor;
-          
-          useDef = visitor.getAllUseDef (instr);
-          for (auto varAndUses : useDef.getUses ()) {
-            std::string strID = varAndUses.first;
-            if (strToLastDefs.count (strID) == 0) {
-              strToLastDefs[strID] = std::unordered_map <BasicBlock*, Instruction*> ();
-            } 
-            
-            strToLastDefs[strID][block] = instr;
-          }        
-        }
-      }
-      
-      levelIter++;
-    }
+  std::vector <std::vector <VersionedSymbol>> uses;
+  std::vector <std::vector <VersionedSymbol>> defs;
+  std::unordered_set <VersionedSymbol> upwardUses;
+  std::unordered_set <VersionedSymbol> blockDefs;
+  std::unordered_map <BasicBlock*, std::vector <VersionedSymbol>> phiUses;
+};
 
-    while (levelQueue.empty () == false) {
-      queue.push (levelQueue.front ());
-      levelQueue.pop ();
+static BlockUseDef blockUseDef (BasicBlock* block)
+{
+  BlockUseDef blockUD;
+  
+  for (auto instr : block->getInstructions ()) {
+    UseDef useDef;
+    UseDefVisitor visitor;
+    std::vector <VersionedSymbol> uses, defs;
+    
+    useDef = visitor.getAllUseDef (instr);
+    for (auto& varAndUses : useDef.getUses ()) {
+      uses.push_back (varAndUses.first);
+      if (!isa<PHI> (instr) && blockUD.blockDefs.count (varAndUses.first) == 0)
+        blockUD.upwardUses.insert (varAndUses.first);
+    }
+    for (auto& varAndDef : useDef.getDefs ()) {
+      defs.push_back (varAndDef.first);
+      blockUD.blockDefs.insert (varAndDef.first);
     }
     
-    //Update the global data structure from the local information.
-    for (auto strToDef : strToLastDefs) {
-      idToLastDef [strToDef.first] = strToDef.second;
+    if (isa<PHI> (instr)) {
+      for (auto& blockIdPair : cast<PHI> (instr)->getCommandExprVector ()) {
+        blockUD.phiUses[blockIdPair.first].push_back (blockIdPair.second->getVersionedSymbol ());
+      }
     }
+    
+    blockUD.uses.push_back (uses);
+    blockUD.defs.push_back (defs);
   }
   
-  program->setLivenessAnalysis (idToLastDef);
+  return blockUD;
 }
 
-void jsonLivenessAnalysis (Program* program)
+//Returns true if block runs on every pass through loop, that is if it
+//dominates every block of loop branching out of it or returning. These
+//blocks are cached in exiting for every loop.
+static bool runsOnEveryIteration (BasicBlock* block, NaturalLoop* loop, DominatorTree& domTree,
+                                  LoopInfo& loopInfo,
+                                  std::unordered_map <NaturalLoop*, std::vector<BasicBlock*>>& exiting)
 {
-  /* This analysis is like live analysis but works at the json key/value
-   * pairs instead of variables. Find if there are only specific 
-   * keys of a json returned from call is used and save only those keys in
-   * the state variable.
-   */
-   
-  UseDef useDef;
-  UseDefVisitor visitor;
-  std::unordered_map <std::string, std::vector<std::vector<Pattern*>>> idToPatterns;
-  std::unordered_set<std::string> fullyUsedId;
-  Program::JSONKeyAnalysis requiredPatterns;
-  useDef = visitor.getAllUseDef (program);
-  for (auto varAndDefs : useDef.getDefs ()) {
-    std::string id = varAndDefs.first;
-    Instruction* def = varAndDefs.second;
-    
-    //Consider only those defs which are from call instructions.
-    if (dynamic_cast<Call*> (def) == nullptr) {
-      continue;
-    }
-    
-    std::unordered_set<Instruction*> uses;
-    uses = useDef.getUses () [id];
+  auto iter = exiting.find (loop);
+  
+  if (iter == exiting.end ()) {
+    std::vector<BasicBlock*>& blocks = exiting[loop];
     
-    for (auto use : uses) {
-      //If any of these uses, use full identifier then we cannot consider
-      //this identifier.
-      //All the partial uses will come in Patterns and Pattern
-      //are assigned through Assignment
-      if (fullyUsedId.count (id) == 1) {
-        continue;
-      }
-      std::vector<Pattern*> patternsForUse;
-      if (dynamic_cast <Assignment*> (use) != nullptr) {
-        Assignment* assign;
-        
-        assign = (Assignment*) use;
-        
-        if (dynamic_cast <PatternApplication*> (((Assignment*)use)->getInput ()) != nullptr) {
-          if (idToPatterns.count (id) == 0) {
-            idToPatterns[id] = std::vector<std::vector<Pattern*>> ();
-          }
-          
-          //Get all the patterns used in this use satement
-          PatternApplication* patApp;
-          std::vector<Pattern*> allPats;
-          std::vector<Pattern*> _allPats;
-                    
-          patApp = (PatternApplication*)((Assignment*)use)->getInput ();
-          allPats = patApp->getAllPatterns ();
-          bool foundArrayIndexPat = false;
-          
-          for (auto iter = allPats.begin(); iter != allPats.end(); ++iter) {
-            Pattern* pat = *iter;
-            
-            if (dynamic_cast <ArrayIndexPattern*> (pat) != nullptr) {
-              //idToPatterns.erase (id);
-              //fullyUsedId.insert (id);
-              foundArrayIndexPat = true;
-              break;
-            }
-            
-            _allPats.push_back (pat);
-          }
-            
-          std::vector<Pattern*> patternsForUse = _allPats;
-          
-          if (!foundArrayIndexPat) {
-            //TODO: Write a better comment
-            //Get all the patterns from the use of this variable 
-            //and other defined temp variables
-            std::string nextId = assign->getOutput ()->getIDWithVersion ();
-            std::queue <std::string> nextIdQueue;
-            nextIdQueue.push (nextId);
-            
-            while (nextIdQueue.empty () == false) {
-              nextId = nextIdQueue.front ();
-              nextIdQueue.pop ();
-              //Explore next temp variables in a level order fashion
-              for (auto nextIdUse : useDef.getUses ()[nextId]) {
-                if (dynamic_cast<Assignment*> (nextIdUse) != nullptr) {
-                  if (dynamic_cast <PatternApplication*> (((Assignment*)nextIdUse)->getInput ()) != nullptr) {
-                    Assignment* a;
-                    a = (Assignment*)nextIdUse;
-  
-                    PatternApplication* patApp = (PatternApplication*)((Assignment*)use)->getInput ();
-                    bool foundArrayIndexPat = false;
-                    
-                    std::vector<Pattern*> allPats = patApp->getAllPatterns ();
-                    std::vector<Pattern*> _allPats;
-                    
-                    for (auto pat : allPats) {
-                      if (dynamic_cast <ArrayIndexPattern*> (pat) != nullptr) {
-                        foundArrayIndexPat = true;
-                        break;
-                      }
-                      
-                      _allPats.push_back (pat);
-                    }
-  
-                    if (foundArrayIndexPat) {
-                      //idToPatterns.erase (id);
-                      //fullyUsedId.insert (id);
-                      break;
-                    } else {
-                      patternsForUse.insert (patternsForUse.begin (), allPats.begin (), allPats.end ());
-                      nextIdQueue.push (a->getOutput ()->getIDWithVersion ());
-                    }
-                  }
-                }
-              }
-            }
-          }
-          
-          idToPatterns[id].push_back (patternsForUse);
-        } else {
-          //For everything else (like assignment of JSON Literal etc.) 
-          //consider everything
-          idToPatterns.erase (id);
-          fullyUsedId.insert (id);
+    for (auto bb : loopInfo.getBlocks (loop)) {
+      if (bb->getSuccessors ().empty ())
+        blocks.push_back (bb);
+      for (auto succ : bb->getSuccessors ()) {
+        if (!loopInfo.contains (loop, succ)) {
+          blocks.push_back (bb);
+          break;
         }
-      } else if (dynamic_cast <Call*> (use) != nullptr) {
-        idToPatterns.erase (id);
-        fullyUsedId.insert (id);
-      } else if (dynamic_cast <ConditionalBranch*> (use) != nullptr) {
-        idToPatterns.erase (id);
-        fullyUsedId.insert (id);
-      } else if (dynamic_cast <Return*> (use) != nullptr) {
-        idToPatterns.erase (id);
-        fullyUsedId.insert (id);
-      }
-        else {
-        std::cout << __FILE__ << ":" << __LINE__ << ":" << "Didn't consider this case " << typeid (*use).name () << std::endl;
       }
     }
+    iter = exiting.find (loop);
   }
   
-  for (auto id : idToPatterns) {
-    std::vector<std::string> unionOfJSONs;
-    for (auto patternVec : id.second) {
-      std::stringstream newJSONObj;
-      std::stringstream patternForJSONObj;
-      //TODO: We are hardcoding ".input" here. Need to improve it.
-        
-      //Create a new object with only require fields and a pattern
-      //to get only required fields.
-      patternForJSONObj << ".input";
-      newJSONObj << "{";
-      for (int i = 0; i < patternVec.size (); i++) {
-        Pattern* pattern = patternVec[i];
-        if (dynamic_cast <KeyGetPattern*> (pattern) != nullptr) {
-          newJSONObj << R"(\")" << ((KeyGetPattern*)pattern)->getKeyName () << R"(\")" << ": ";
-        } else if (dynamic_cast <FieldGetPattern*> (pattern) != nullptr) {
-          newJSONObj << R"(\")" << ((FieldGetPattern*)pattern)->getFieldName () << R"(\")" << ": ";
-        }
-        
-        newJSONObj << "{";
-        patternForJSONObj << pattern->convert ();
-      }
-      
-      newJSONObj << patternForJSONObj.str ();
-      for (int i = 0; i < patternVec.size (); i++) {
-        newJSONObj << "}";
-      }
-      
-      unionOfJSONs.push_back (newJSONObj.str ());
-    }
+  for (auto bb : iter->second) {
+    if (!domTree.dominates (block, bb))
+      return false;
+  }
+  
+  return true;
+}
+
+//Returns true if instr computes the same value on every iteration of
+//loop, given the blocks defining the values it uses and the blocks storing
+//to every pointer.
+static bool isLoopInvariant (Instruction* instr, const std::vector<VersionedSymbol>& uses,
+                             LoopInfo& loopInfo, NaturalLoop* loop,
+                             std::unordered_map <VersionedSymbol, BasicBlock*>& defBlocks,
+                             std::unordered_map <std::string, std::vector<BasicBlock*>>& storeBlocks)
+{
+  for (auto value : uses) {
+    auto def = defBlocks.find (value);
+    
+    if (def != defBlocks.end () && loopInfo.contains (loop, def->second))
+      return false;
+  }
+  
+  if (isa<LoadPointer> (instr)) {
+    for (auto block : storeBlocks[cast<LoadPointer> (instr)->getPointer ()->getName ()]) {
+      if (loopInfo.contains (loop, block))
+        return false;
+    }
+    
+    return true;
+  }
+  
+  return isa<Assignment> (instr) && !isa<Constant> (cast<Assignment> (instr)->getInput ());
+}
+
+void loopInvariantCodeMotion (Program* program)
+{
+  /* Loop invariant code motion.
+   * Assignments whose operands are defined outside of a natural loop, or by
+   * other invariant instructions, and loads of pointers the loop never
+   * stores to give the same value on every iteration. They are moved to
+   * the end of the preheader of the outermost loop they are invariant in,
+   * and run once before it. Blocks are visited in reverse postorder, so the
+   * definitions an instruction depends on are hoisted before it.
+   * Loops without a preheader, and the loops around them, are left alone.
+   * A projection fails on a value of the wrong type, .a.b[0] of a number,
+   * so only instructions of blocks running on every iteration are hoisted,
+   * those dominating every exit of the loop. Loops are rotated, their
+   * preheader only runs when the first iteration does.
+   * A hoisted value is carried in the saved state through the whole loop,
+   * constants are cheaper to set again in the projection using them and
+   * stay where they are.
+   * */
+  DominatorTree domTree (program->getBasicBlocks ()[0]);
+  LoopInfo loopInfo (domTree);
+  std::unordered_map <VersionedSymbol, BasicBlock*> defBlocks;
+  std::unordered_map <std::string, std::vector<BasicBlock*>> storeBlocks;
+  std::unordered_map <BasicBlock*, std::vector<Instruction*>> hoisted;
+  std::unordered_map <BasicBlock*, std::vector<Instruction*>> remaining;
+  std::unordered_map <NaturalLoop*, std::vector<BasicBlock*>> exiting;
+  
+  if (loopInfo.getLoops ().empty ())
+    return;
+  
+  for (auto block : domTree.getReversePostOrder ()) {
+    for (auto instr : block->getInstructions ()) {
+      UseDefVisitor visitor;
+      UseDef useDef = visitor.getAllUseDef (instr);
+      
+      for (auto& varAndDef : useDef.getDefs ()) {
+        defBlocks[varAndDef.first] = block;
+      }
+      if (isa<StorePointer> (instr))
+        storeBlocks[cast<StorePointer> (instr)->getPointer ()->getName ()].push_back (block);
+    }
+  }
+  
+  for (auto block : domTree.getReversePostOrder ()) {
+    BlockUseDef blockUD = blockUseDef (block);
+    const std::vector<Instruction*>& instrs = block->getInstructions ();
+    
+    for (size_t i = 0; i < instrs.size (); i++) {
+      BasicBlock* target = nullptr;
+      
+      for (NaturalLoop* loop = loopInfo.getLoopFor (block); loop != nullptr; loop = loop->parent) {
+        BasicBlock* preheader = loopInfo.getPreheader (loop);
+        
+        if (preheader == nullptr || !runsOnEveryIteration (block, loop, domTree, loopInfo, exiting) ||
+            !isLoopInvariant (instrs[i], blockUD.uses[i], loopInfo, loop, defBlocks, storeBlocks))
+          break;
+        target = preheader;
+      }
+      
+      if (target == nullptr) {
+        remaining[block].push_back (instrs[i]);
+        continue;
+      }
+      
+      hoisted[target].push_back (instrs[i]);
+      for (auto value : blockUD.defs[i]) {
+        defBlocks[value] = target;
+      }
+    }
+  }
+  
+  for (auto block : domTree.getReversePostOrder ()) {
+    std::vector<Instruction*>& instrs = remaining[block];
+    std::vector<Instruction*>& moved = hoisted[block];
+    
+    if (instrs.size () == block->getInstructions ().size () && moved.empty ())
+      continue;
+    
+    //Before the branch to the loop header.
+    if (!moved.empty ())
+      instrs.insert (instrs.end () - 1, moved.begin (), moved.end ());
+    block->setInstructions (instrs);
+  }
+}
+
+//The block instr defining a value can be moved to, the nearest common
+//dominator of the blocks using it, out of the loops not containing block,
+//or nullptr if it has to stay in block.
+static BasicBlock* sinkTarget (Instruction* instr, BasicBlock* block, DominatorTree& domTree,
+                               LoopInfo& loopInfo, UseDef& useDef,
+                               std::unordered_map <Instruction*, BasicBlock*>& blockOf)
+{
+  std::vector<Identifier*> uses;
+  Identifier* def;
+  BasicBlock* target = nullptr;
+  NaturalLoop* outermost = nullptr;
+
+  getUsesAndDef (instr, uses, def);
+  auto useIter = useDef.getUses ().find (def->getVersionedSymbol ());
+
+  if (useIter == useDef.getUses ().end ())
+    return nullptr;
+
+  for (auto use : useIter->second) {
+    std::vector<BasicBlock*> useBlocks;
+
+    //A PHI operand is read on the edge from its predecessor.
+    if (isa<PHI> (use)) {
+      for (auto& blockIdPair : cast<PHI> (use)->getCommandExprVector ()) {
+        if (blockIdPair.second->getVersionedSymbol () == def->getVersionedSymbol ())
+          useBlocks.push_back (blockIdPair.first);
+      }
+    } else {
+      useBlocks.push_back (blockOf[use]);
+    }
+
+    for (auto useBlock : useBlocks) {
+      if (useBlock == block || !domTree.isReachable (useBlock))
+        return nullptr;
+      target = (target == nullptr) ? useBlock : domTree.nearestCommonDominator (target, useBlock);
+    }
+  }
+
+  if (target == nullptr || target == block)
+    return nullptr;
+
+  for (NaturalLoop* loop = loopInfo.getLoopFor (target); loop != nullptr; loop = loop->parent) {
+    if (!loopInfo.contains (loop, block))
+      outermost = loop;
+  }
+  if (outermost != nullptr)
+    target = domTree.getIDom (outermost->header);
+
+  return (target == block) ? nullptr : target;
+}
+
+void codeSinking (Program* program, const std::unordered_set<std::string>& pureActions)
+{
+  /* Code sinking.
+   * An assignment, or a call to a pure action, is moved from its block to
+   * the nearest common dominator of the blocks using its value, so that
+   * the paths not reaching a use neither run it nor carry its value in the
+   * saved state. PHI operands are used in the predecessor they come from.
+   * Blocks are visited in postorder and instructions from the last, so
+   * the uses of a value are moved before it is and it follows them. It is
+   * never moved into a loop it is not in, which would run it on every
+   * iteration, but only to the block before the outermost such loop.
+   * Moved instructions are placed after the PHIs of their new block, in
+   * the order they were in, before every use there.
+   * */
+  DominatorTree domTree (program->getBasicBlocks ()[0]);
+  LoopInfo loopInfo (domTree);
+  UseDefVisitor visitor;
+  UseDef useDef = visitor.getAllUseDef (program);
+  std::unordered_map <Instruction*, BasicBlock*> blockOf;
+  std::unordered_map <BasicBlock*, std::vector<Instruction*>> sunk;
+  const std::vector<BasicBlock*>& rpo = domTree.getReversePostOrder ();
+
+  for (auto block : rpo) {
+    for (auto instr : block->getInstructions ()) {
+      blockOf[instr] = block;
+    }
+  }
+
+  for (int i = (int)rpo.size () - 1; i >= 0; i--) {
+    BasicBlock* block = rpo[i];
+    const std::vector<Instruction*>& instrs = block->getInstructions ();
+    std::vector<Instruction*> kept;
+
+    for (int j = (int)instrs.size () - 1; j >= 0; j--) {
+      Instruction* instr = instrs[j];
+      BasicBlock* target = nullptr;
+
+      if (isa<Assignment> (instr) ||
+          (isa<Call> (instr) && pureActions.count (cast<Call> (instr)->getActionName ()) != 0))
+        target = sinkTarget (instr, block, domTree, loopInfo, useDef, blockOf);
+
+      if (target == nullptr) {
+        kept.push_back (instr);
+        continue;
+      }
+
+      sunk[target].push_back (instr);
+      blockOf[instr] = target;
+    }
+
+    if (kept.size () != instrs.size ()) {
+      std::reverse (kept.begin (), kept.end ());
+      block->setInstructions (kept);
+    }
+  }
+
+  for (auto& blockAndSunk : sunk) {
+    std::vector<Instruction*> instrs = blockAndSunk.first->getInstructions ();
+    auto firstNonPHI = std::find_if (instrs.begin (), instrs.end (),
+                                     [] (Instruction* instr) {return !isa<PHI> (instr);});
+
+    instrs.insert (firstNonPHI, blockAndSunk.second.rbegin (), blockAndSunk.second.rend ());
+    blockAndSunk.first->setInstructions (instrs);
+  }
+}
+
+//Makes the terminator of pred branch to newTarget instead of target.
+static void replaceSuccessor (BasicBlock* pred, BasicBlock* target, BasicBlock* newTarget)
+{
+  Instruction* terminator = pred->getInstructions ().back ();
+  std::vector<BasicBlock*>& succs = pred->getSuccessors ();
+  
+  if (isa<DirectBranch> (terminator)) {
+    cast<DirectBranch> (terminator)->setTarget (newTarget);
+  } else {
+    ConditionalBranch* condBr = cast<ConditionalBranch> (terminator);
+    
+    if (condBr->getThenBranch () == target)
+      condBr->setThenBranch (newTarget);
+    if (condBr->getElseBranch () == target)
+      condBr->setElseBranch (newTarget);
+  }
+  
+  std::replace (succs.begin (), succs.end (), target, newTarget);
+}
+
+static void removePredecessor (BasicBlock* block, BasicBlock* pred)
+{
+  std::vector<BasicBlock*>& preds = block->getPredecessors ();
+  
+  preds.erase (std::remove (preds.begin (), preds.end (), pred), preds.end ());
+  for (auto instr : block->getInstructions ()) {
+    if (isa<PHI> (instr))
+      cast<PHI> (instr)->removeIncoming (pred);
+  }
+}
+
+//Whether every use of the PHIs of block is in a PHI of target, for the
+//edge from block.
+static bool onlyFeedsTarget (BasicBlock* block, BasicBlock* target, UseDef& useDef)
+{
+  const std::vector<Instruction*>& instrs = block->getInstructions ();
+  
+  for (int i = 0; i < (int)instrs.size () - 1; i++) {
+    VersionedSymbol output = cast<PHI> (instrs[i])->getOutput ()->getVersionedSymbol ();
+    
+    for (auto use : useDef.getUses ()[output]) {
+      if (!isa<PHI> (use))
+        return false;
+      
+      for (auto& blockIdPair : cast<PHI> (use)->getCommandExprVector ()) {
+        if (blockIdPair.second->getVersionedSymbol () == output && blockIdPair.first != block)
+          return false;
+      }
+      if (std::find (target->getInstructions ().begin (), target->getInstructions ().end (), use) ==
+          target->getInstructions ().end ())
+        return false;
+    }
+  }
+  
+  return true;
+}
+
+//Makes pred, branching on a condition to both the empty block and its
+//target, branch to target directly, if the PHIs of target get the same
+//values from both.
+static bool foldBranchToTarget (BasicBlock* pred, BasicBlock* block, BasicBlock* target)
+{
+  std::vector<Instruction*> instrs = pred->getInstructions ();
+  std::vector<BasicBlock*>& targetPreds = target->getPredecessors ();
+  
+  if (!isa<ConditionalBranch> (instrs.back ()) || block->getInstructions ().size () != 1)
+    return false;
+  
+  for (auto instr : target->getInstructions ()) {
+    if (isa<PHI> (instr) && cast<PHI> (instr)->getIncoming (block)->getVersionedSymbol () !=
+        cast<PHI> (instr)->getIncoming (pred)->getVersionedSymbol ())
+      return false;
+  }
+  
+  //The direct branch adds the edge to target again.
+  removePredecessor (block, pred);
+  targetPreds.erase (std::find (targetPreds.begin (), targetPreds.end (), pred));
+  pred->getSuccessors ().clear ();
+  instrs.back () = arenaNew<DirectBranch> (target, pred);
+  pred->setInstructions (instrs);
+  
+  return true;
+}
+
+//Branches from the predecessors of block, which holds nothing but a branch
+//to its target and PHIs only the PHIs of the target use, straight to the
+//target. The PHIs of the target then take the values of the PHIs of block
+//from each predecessor. A predecessor already branching to the target
+//keeps its branch to block, the PHIs of the target cannot tell the two
+//edges apart, unless it can branch to the target only.
+static bool forwardEmptyBlock (BasicBlock* block, UseDef& useDef)
+{
+  const std::vector<Instruction*>& instrs = block->getInstructions ();
+  std::unordered_map <VersionedSymbol, PHI*> blockPHIs;
+  BasicBlock* target;
+  bool changed = false;
+  
+  if (instrs.empty () || !isa<DirectBranch> (instrs.back ()))
+    return false;
+  
+  for (int i = 0; i < (int)instrs.size () - 1; i++) {
+    if (!isa<PHI> (instrs[i]))
+      return false;
+    blockPHIs[cast<PHI> (instrs[i])->getOutput ()->getVersionedSymbol ()] = cast<PHI> (instrs[i]);
+  }
+  
+  target = cast<DirectBranch> (instrs.back ())->getTarget ();
+  if (target == block || !onlyFeedsTarget (block, target, useDef))
+    return false;
+  
+  std::vector<BasicBlock*> preds = block->getPredecessors ();
+  for (auto pred : preds) {
+    std::vector<BasicBlock*>& targetPreds = target->getPredecessors ();
+    
+    if (std::find (targetPreds.begin (), targetPreds.end (), pred) != targetPreds.end ()) {
+      changed |= foldBranchToTarget (pred, block, target);
+      continue;
+    }
+    
+    replaceSuccessor (pred, block, target);
+    targetPreds.push_back (pred);
+    for (auto instr : target->getInstructions ()) {
+      if (!isa<PHI> (instr))
+        continue;
+      
+      PHI* phi = cast<PHI> (instr);
+      Identifier* value = phi->getIncoming (block);
+      auto iter = blockPHIs.find (value->getVersionedSymbol ());
+      
+      if (iter != blockPHIs.end ())
+        value = iter->second->getIncoming (pred);
+      phi->addIncoming (pred, value);
+      useDef.getUses ()[value->getVersionedSymbol ()].insert (phi);
+    }
+    
+    //Keep the uses up to date, so that the predecessors are forwarded
+    //next in the same round.
+    for (auto& outputAndPHI : blockPHIs) {
+      PHI* phi = outputAndPHI.second;
+      VersionedSymbol value = phi->getIncoming (pred)->getVersionedSymbol ();
+      int count = 0;
+      
+      for (auto& blockIdPair : phi->getCommandExprVector ()) {
+        if (blockIdPair.second->getVersionedSymbol () == value)
+          count++;
+      }
+      if (count == 1)
+        useDef.getUses ()[value].erase (phi);
+    }
+    removePredecessor (block, pred);
+    changed = true;
+  }
+  
+  return changed;
+}
+
+//Makes every use of value name newValue instead, and updates useDef.
+static void replaceAllUses (VersionedSymbol value, Identifier* newValue, UseDef& useDef)
+{
+  std::unordered_set<Instruction*>& newUses = useDef.getUses ()[newValue->getVersionedSymbol ()];
+  
+  for (auto use : useDef.getUses ()[value]) {
+    std::vector<Identifier*> ids;
+    Identifier* def;
+    
+    getUsesAndDef (use, ids, def);
+    if (isa<PHI> (use)) {
+      for (auto& blockIdPair : cast<PHI> (use)->getCommandExprVector ()) {
+        ids.push_back (blockIdPair.second);
+      }
+    }
+    for (auto id : ids) {
+      if (id->getVersionedSymbol () == value)
+        id->replaceWith (newValue);
+    }
+    newUses.insert (use);
+  }
+  
+  useDef.getUses ().erase (value);
+}
+
+//Appends block to its only predecessor, if that predecessor branches to
+//block only. The PHIs of block have a single value, their uses name it
+//instead.
+static bool mergeIntoPredecessor (BasicBlock* block, UseDef& useDef)
+{
+  BasicBlock* pred;
+  
+  if (block->getPredecessors ().size () != 1)
+    return false;
+  
+  pred = block->getPredecessors ()[0];
+  if (pred == block || pred->getSuccessors ().size () != 1)
+    return false;
+  
+  std::vector<Instruction*> instrs = pred->getInstructions ();
+  instrs.pop_back ();
+  //A PHI with a single incoming value is that value.
+  for (auto instr : block->getInstructions ()) {
+    if (isa<PHI> (instr)) {
+      PHI* phi = cast<PHI> (instr);
+      
+      useDef.getUses ()[phi->getIncoming (pred)->getVersionedSymbol ()].erase (phi);
+      replaceAllUses (phi->getOutput ()->getVersionedSymbol (), phi->getIncoming (pred), useDef);
+    } else {
+      instrs.push_back (instr);
+    }
+  }
+  pred->setInstructions (instrs);
+  pred->getSuccessors () = block->getSuccessors ();
+  if (isa<DirectBranch> (instrs.back ()))
+    cast<DirectBranch> (instrs.back ())->setParent (pred);
+  else if (isa<ConditionalBranch> (instrs.back ()))
+    cast<ConditionalBranch> (instrs.back ())->setParent (pred);
+  
+  for (auto succ : block->getSuccessors ()) {
+    std::vector<BasicBlock*>& succPreds = succ->getPredecessors ();
+    
+    std::replace (succPreds.begin (), succPreds.end (), block, pred);
+    for (auto instr : succ->getInstructions ()) {
+      if (isa<PHI> (instr))
+        cast<PHI> (instr)->replaceIncomingBlock (block, pred);
+    }
+  }
+  
+  return true;
+}
+
+//Whether block branches only to the header of a loop it is not part of.
+static bool isPreheader (BasicBlock* block, DominatorTree& domTree)
+{
+  const std::vector<Instruction*>& instrs = block->getInstructions ();
+  BasicBlock* header;
+  
+  if (instrs.empty () || !isa<DirectBranch> (instrs.back ()))
+    return false;
+  
+  header = cast<DirectBranch> (instrs.back ())->getTarget ();
+  if (domTree.dominates (header, block))
+    return false;
+  
+  for (auto pred : header->getPredecessors ()) {
+    if (domTree.isReachable (pred) && domTree.dominates (header, pred))
+      return true;
+  }
+  
+  return false;
+}
+
+void simplifyCFG (Program* program, bool keepPreheaders = false)
+{
+  /* CFG simplification.
+   * The lowering leaves a block after every if, loop and return, and passes
+   * can empty blocks. Every block is a sequence of its own, and a branch
+   * to it another projection and dispatch at run time. Blocks not reachable
+   * from the entry are removed, branches to a block holding only a direct
+   * branch, and PHIs feeding the PHIs of its target, go to its target
+   * instead, and a block with a single predecessor
+   * branching only to it is appended to that predecessor, until nothing
+   * changes.
+   * With keepPreheaders the empty block before a loop is not forwarded,
+   * for the passes after it hoisting into the preheader.
+   * */
+  std::vector<BasicBlock*>& blocks = program->getBasicBlocks ();
+  BasicBlock* entry = blocks[0];
+  std::unordered_set<BasicBlock*> removed;
+  bool changed = true;
+  
+  while (changed) {
+    DominatorTree domTree (entry);
+    const std::vector<BasicBlock*>& rpo = domTree.getReversePostOrder ();
+    UseDefVisitor visitor;
+    
+    for (auto block : blocks) {
+      if (domTree.isReachable (block))
+        continue;
+      
+      for (auto succ : block->getSuccessors ()) {
+        if (domTree.isReachable (succ))
+          removePredecessor (succ, block);
+      }
+      removed.insert (block);
+    }
+    blocks.erase (std::remove_if (blocks.begin (), blocks.end (),
+                                  [&removed] (BasicBlock* block) {return removed.count (block) != 0;}),
+                  blocks.end ());
+    UseDef useDef = visitor.getAllUseDef (program);
+    
+    //Later blocks first, so that the predecessors of a chain of blocks
+    //forwarded to the same target move once.
+    changed = false;
+    for (auto iter = rpo.rbegin (); iter != rpo.rend (); iter++) {
+      BasicBlock* block = *iter;
+      
+      if (block == entry || removed.count (block) != 0)
+        continue;
+      
+      if (!(keepPreheaders && isPreheader (block, domTree)) && forwardEmptyBlock (block, useDef)) {
+        changed = true;
+        if (block->getPredecessors ().empty ()) {
+          removePredecessor (block->getSuccessors ()[0], block);
+          removed.insert (block);
+          continue;
+        }
+      }
+      
+      if (mergeIntoPredecessor (block, useDef)) {
+        changed = true;
+        removed.insert (block);
+      }
+    }
+  }
+  
+  blocks.erase (std::remove_if (blocks.begin (), blocks.end (),
+                                [&removed] (BasicBlock* block) {return removed.count (block) != 0;}),
+                blocks.end ());
+}
+
+//The value computed by instr, with its operands named by their leaders,
+//or "" if it is not numbered.
+//The structure of expr, its node kinds and contents, or "" if expr is not
+//numbered. Unlike its code, it tells apart a string from the number it
+//spells and literals whose code is not complete.
+static std::string expressionKey (Expression* expr)
+{
+  switch (expr->getKind ()) {
+    case IRNode::IdentifierKind:
+    case IRNode::InputKind:
+      return "id " + expr->convert ();
+    case IRNode::NumberKind:
+      return "number " + expr->convert ();
+    case IRNode::BooleanKind:
+      return "boolean " + expr->convert ();
+    case IRNode::StringKind: {
+      const std::string& str = cast<String> (expr)->getString ();
+
+      return "string " + std::to_string (str.size ()) + " " + str;
+    }
+    case IRNode::ArrayKind: {
+      std::string key = "array (";
+
+      for (auto element : cast<Array> (expr)->getExpressions ()) {
+        std::string elementKey = expressionKey (element);
+
+        if (elementKey == "")
+          return "";
+        key += elementKey + ", ";
+      }
+
+      return key + ")";
+    }
+    case IRNode::JSONObjectKind: {
+      std::string key = "object (";
+
+      for (auto kvpair : cast<JSONObject> (expr)->getKeyValuePairs ()) {
+        std::string pairKey = expressionKey (kvpair->getValue ());
+
+        if (pairKey == "")
+          return "";
+        key += std::to_string (kvpair->getKey ().size ()) + " " + kvpair->getKey () + ": " + pairKey + ", ";
+      }
+
+      return key + ")";
+    }
+    case IRNode::PatternApplicationKind: {
+      PatternApplication* app = cast<PatternApplication> (expr);
+      std::string key = expressionKey (app->getIdentifier ());
+
+      if (key == "")
+        return "";
+
+      return "apply (" + key + ") " + app->getPattern ()->convert ();
+    }
+    case IRNode::ConditionalKind: {
+      Conditional* cond = cast<Conditional> (expr);
+      std::string key1 = expressionKey (cond->getOp1 ());
+      std::string key2 = expressionKey (cond->getOp2 ());
+
+      if (key1 == "" || key2 == "")
+        return "";
+
+      return "(" + key1 + ") " + conditionalOpConvert (cond->getOperator ()) + " (" + key2 + ")";
+    }
+    default:
+      return "";
+  }
+}
+
+static std::string valueKey (Instruction* instr, const std::unordered_set<std::string>& pureActions)
+{
+  if (isa<Assignment> (instr))
+    return expressionKey (cast<Assignment> (instr)->getInput ());
+
+  Call* call = dyn_cast<Call> (instr);
+
+  if (call == nullptr || pureActions.count (call->getActionName ()) == 0)
+    return "";
+
+  std::string key = expressionKey (call->getArgument ());
+
+  if (key == "")
+    return "";
+
+  return "call " + call->getActionName () + " " + key;
+}
+
+//The value every operand of phi other than itself is, with its operands
+//named by their leaders, or nullptr if they differ.
+static Identifier* singleIncomingValue (PHI* phi, std::unordered_map <VersionedSymbol, Identifier*>& replaced)
+{
+  VersionedSymbol output = phi->getOutput ()->getVersionedSymbol ();
+  Identifier* value = nullptr;
+
+  for (auto& blockIdPair : phi->getCommandExprVector ()) {
+    Identifier* operand = blockIdPair.second;
+    auto leader = replaced.find (operand->getVersionedSymbol ());
+
+    if (leader != replaced.end ())
+      operand = leader->second;
+    if (operand->getVersionedSymbol () == output)
+      continue;
+    if (value != nullptr && value->getVersionedSymbol () != operand->getVersionedSymbol ())
+      return nullptr;
+    value = operand;
+  }
+
+  return value;
+}
+
+void globalValueNumbering (Program* program, const std::unordered_set<std::string>& pureActions)
+{
+  /* Global value numbering.
+   * Every assignment, and every call to a pure action, is keyed by the
+   * structure of its expression, or action and argument, see
+   * expressionKey, after its operands are
+   * renamed to their leaders. The dominator tree is walked in preorder with
+   * the keys of the dominating blocks in scope, and an instruction whose
+   * key is already there is removed, its uses naming the leader instead.
+   * Definitions dominate their uses, so every use but a PHI operand is
+   * renamed before its instruction is keyed. PHI operands are renamed last.
+   * Copies, and PHIs whose operands are all the same value, are removed
+   * the same way, their uses naming that value.
+   * Constants are only numbered in their block, like in
+   * loopInvariantCodeMotion they are cheaper to set again than to carry
+   * in the saved state.
+   * */
+  DominatorTree domTree (program->getBasicBlocks ()[0]);
+  std::unordered_map <std::string, Identifier*> leaders;
+  std::vector <std::string> scope;
+  std::unordered_map <VersionedSymbol, Identifier*> replaced;
+  //The block and the size of scope before it.
+  std::vector <std::pair <BasicBlock*, int>> stack;
+  std::unordered_map <BasicBlock*, int> rpoNumber;
+
+  for (size_t i = 0; i < domTree.getReversePostOrder ().size (); i++) {
+    rpoNumber[domTree.getReversePostOrder ()[i]] = i;
+  }
+
+  stack.push_back (std::make_pair (domTree.getEntry (), -1));
+  while (stack.empty () == false) {
+    BasicBlock* block = stack.back ().first;
+
+    if (stack.back ().second != -1) {
+      for (int i = stack.back ().second; i < (int)scope.size (); i++) {
+        leaders.erase (scope[i]);
+      }
+      scope.resize (stack.back ().second);
+      stack.pop_back ();
+      continue;
+    }
+
+    std::unordered_map <std::string, Identifier*> constants;
+    std::vector<Instruction*> kept;
+
+    stack.back ().second = scope.size ();
+    for (auto instr : block->getInstructions ()) {
+      std::vector<Identifier*> uses;
+      Identifier* def;
+      std::string key;
+
+      getUsesAndDef (instr, uses, def);
+      for (auto use : uses) {
+        auto leader = replaced.find (use->getVersionedSymbol ());
+
+        if (leader != replaced.end ())
+          use->replaceWith (leader->second);
+      }
+
+      //A PHI of a single value is that value.
+      if (isa<PHI> (instr)) {
+        Identifier* value = singleIncomingValue (cast<PHI> (instr), replaced);
+
+        if (value != nullptr) {
+          replaced[def->getVersionedSymbol ()] = value;
+          continue;
+        }
+      }
+
+      //A copy is the value it copies.
+      if (isa<Assignment> (instr) && isa<Identifier> (cast<Assignment> (instr)->getInput ()) &&
+          !isa<Input> (cast<Assignment> (instr)->getInput ())) {
+        replaced[def->getVersionedSymbol ()] = cast<Identifier> (cast<Assignment> (instr)->getInput ());
+        continue;
+      }
+
+      key = valueKey (instr, pureActions);
+      if (key == "") {
+        kept.push_back (instr);
+        continue;
+      }
+
+      bool isConstant = isa<Assignment> (instr) && isa<Constant> (cast<Assignment> (instr)->getInput ());
+      auto inserted = (isConstant ? constants : leaders).insert (std::make_pair (key, def));
+
+      if (inserted.second == false) {
+        replaced[def->getVersionedSymbol ()] = inserted.first->second;
+        continue;
+      }
+
+      if (!isConstant)
+        scope.push_back (key);
+      kept.push_back (instr);
+    }
+
+    if (kept.size () != block->getInstructions ().size ())
+      block->setInstructions (kept);
+    //Children in reverse postorder, so that the predecessors of a join are
+    //visited before it.
+    std::vector<BasicBlock*> children = domTree.getChildren (block);
+
+    std::sort (children.begin (), children.end (),
+               [&rpoNumber] (BasicBlock* b1, BasicBlock* b2) {return rpoNumber[b1] > rpoNumber[b2];});
+    for (auto child : children) {
+      stack.push_back (std::make_pair (child, -1));
+    }
+  }
+
+  if (replaced.empty ())
+    return;
+
+  for (auto block : domTree.getReversePostOrder ()) {
+    for (auto instr : block->getInstructions ()) {
+      if (!isa<PHI> (instr))
+        break;
+
+      for (auto& blockIdPair : cast<PHI> (instr)->getCommandExprVector ()) {
+        auto leader = replaced.find (blockIdPair.second->getVersionedSymbol ());
+
+        if (leader != replaced.end ())
+          blockIdPair.second->replaceWith (leader->second);
+      }
+    }
+  }
+}
+
+//Value of an SSA value in sparseConditionalConstantPropagation, from not
+//known to be defined yet to a constant to any value.
+struct LatticeValue
+{
+  enum State {Unknown, Known, Overdefined};
+
+  State state;
+  Constant* constant;
+
+  LatticeValue () : state(Unknown), constant(nullptr) {}
+  LatticeValue (State _state, Constant* _constant) : state(_state), constant(_constant) {}
+};
+
+//Orders constants like jq does: booleans, false first, then numbers, then
+//strings.
+static int compareConstants (Constant* c1, Constant* c2)
+{
+  if (c1->getKind () != c2->getKind ())
+    return c1->getKind () == IRNode::BooleanKind ||
+      (c1->getKind () == IRNode::NumberKind && c2->getKind () == IRNode::StringKind) ? -1 : 1;
+
+  switch (c1->getKind ()) {
+    case IRNode::NumberKind:
+      return (cast<Number> (c1)->getNumber () > cast<Number> (c2)->getNumber ()) -
+        (cast<Number> (c1)->getNumber () < cast<Number> (c2)->getNumber ());
+    case IRNode::StringKind:
+      return cast<String> (c1)->getString ().compare (cast<String> (c2)->getString ());
+    default:
+      return cast<Boolean> (c1)->getBoolean () - cast<Boolean> (c2)->getBoolean ();
+  }
+}
+
+static bool evaluateComparison (ConditionalOperator op, int comparison)
+{
+  switch (op) {
+    case ConditionalOperator::EQ:
+      return comparison == 0;
+    case ConditionalOperator::NE:
+      return comparison != 0;
+    case ConditionalOperator::GT:
+      return comparison > 0;
+    case ConditionalOperator::GE:
+      return comparison >= 0;
+    case ConditionalOperator::LT:
+      return comparison < 0;
+    case ConditionalOperator::LE:
+      return comparison <= 0;
+    default:
+      fprintf (stderr, "Invalid comparison operator %d\n", (int)op);
+      abort ();
+  }
+}
+
+static LatticeValue meet (const LatticeValue& v1, const LatticeValue& v2)
+{
+  if (v1.state == LatticeValue::Unknown)
+    return v2;
+  if (v2.state == LatticeValue::Unknown)
+    return v1;
+  if (v1.state == LatticeValue::Overdefined || v2.state == LatticeValue::Overdefined ||
+      compareConstants (v1.constant, v2.constant) != 0)
+    return LatticeValue (LatticeValue::Overdefined, nullptr);
+
+  return v1;
+}
+
+//The value of an operand, values without a definition are the input.
+static LatticeValue operandValue (Expression* expr, std::unordered_set<VersionedSymbol>& defined,
+                                  std::unordered_map <VersionedSymbol, LatticeValue>& values)
+{
+  Identifier* id = dyn_cast<Identifier> (expr);
+  
+  if (isa<Constant> (expr))
+    return LatticeValue (LatticeValue::Known, cast<Constant> (expr));
+
+  if (id == nullptr || defined.count (id->getVersionedSymbol ()) == 0)
+    return LatticeValue (LatticeValue::Overdefined, nullptr);
+
+  return values[id->getVersionedSymbol ()];
+}
+
+typedef std::unordered_map <VersionedSymbol, std::vector<std::pair<Instruction*, BasicBlock*>>> ValueUses;
+
+//The instructions reading every value, PHIs included, with their blocks,
+//and the values defined in program.
+static void collectUses (Program* program, ValueUses& uses, std::unordered_set<VersionedSymbol>& defined)
+{
+  for (auto block : program->getBasicBlocks ()) {
+    for (auto instr : block->getInstructions ()) {
+      std::vector<Identifier*> instrUses;
+      Identifier* def;
+
+      getUsesAndDef (instr, instrUses, def);
+      if (isa<PHI> (instr)) {
+        for (auto& blockIdPair : cast<PHI> (instr)->getCommandExprVector ()) {
+          instrUses.push_back (blockIdPair.second);
+        }
+      }
+      for (auto use : instrUses) {
+        uses[use->getVersionedSymbol ()].push_back (std::make_pair (instr, block));
+      }
+      if (def != nullptr)
+        defined.insert (def->getVersionedSymbol ());
+    }
+  }
+}
+
+void sparseConditionalConstantPropagation (Program* program)
+{
+  /* Sparse conditional constant propagation, after Wegman and Zadeck.
+   * Values start unknown and blocks unreachable. From the entry, the
+   * instructions of every block reached are evaluated, and again when a
+   * value they use changes. An assignment of a constant, a copy of a
+   * constant, or a PHI whose operands on the reached edges are all the same
+   * constant is that constant, anything else computed at run time is
+   * overdefined. A conditional branch comparing two constants only reaches
+   * the arm it takes.
+   * Afterwards, those branches become direct branches to that arm, PHIs and
+   * copies of a constant set the constant instead, and constants without
+   * uses are removed. The arm never taken is left unreachable for
+   * simplifyCFG to remove.
+   * */
+  std::vector<BasicBlock*>& blocks = program->getBasicBlocks ();
+  ValueUses uses;
+  std::unordered_set <VersionedSymbol> defined;
+  std::unordered_map <VersionedSymbol, LatticeValue> values;
+  std::set <std::pair <BasicBlock*, BasicBlock*>> executableEdges;
+  std::unordered_set <BasicBlock*> executable;
+  std::vector <std::pair <BasicBlock*, BasicBlock*>> edgeWorklist;
+  std::vector <std::pair <Instruction*, BasicBlock*>> instrWorklist;
+  bool changed = false;
+
+  collectUses (program, uses, defined);
+
+  edgeWorklist.push_back (std::make_pair (nullptr, blocks[0]));
+  while (edgeWorklist.empty () == false || instrWorklist.empty () == false) {
+    std::vector<Instruction*> toVisit;
+    BasicBlock* block;
+
+    if (edgeWorklist.empty () == false) {
+      std::pair <BasicBlock*, BasicBlock*> edge = edgeWorklist.back ();
+
+      edgeWorklist.pop_back ();
+      if (executableEdges.insert (edge).second == false)
+        continue;
+
+      block = edge.second;
+      bool reached = executable.insert (block).second;
+
+      for (auto instr : block->getInstructions ()) {
+        if (reached || isa<PHI> (instr))
+          toVisit.push_back (instr);
+      }
+    } else {
+      Instruction* instr = instrWorklist.back ().first;
+
+      block = instrWorklist.back ().second;
+      instrWorklist.pop_back ();
+      if (executable.count (block) == 0)
+        continue;
+      toVisit.push_back (instr);
+    }
+
+    for (auto instr : toVisit) {
+      std::vector<Identifier*> instrUses;
+      Identifier* def;
+      LatticeValue value (LatticeValue::Overdefined, nullptr);
+
+      if (isa<DirectBranch> (instr)) {
+        edgeWorklist.push_back (std::make_pair (block, cast<DirectBranch> (instr)->getTarget ()));
+        continue;
+      }
+
+      if (isa<ConditionalBranch> (instr)) {
+        ConditionalBranch* condBr = cast<ConditionalBranch> (instr);
+        Conditional* cond = condBr->getCondition ();
+        LatticeValue op1 = operandValue (cond->getOp1 (), defined, values);
+        LatticeValue op2 = operandValue (cond->getOp2 (), defined, values);
+
+        if (op1.state == LatticeValue::Known && op2.state == LatticeValue::Known) {
+          bool taken = evaluateComparison (cond->getOperator (), compareConstants (op1.constant, op2.constant));
+
+          edgeWorklist.push_back (std::make_pair (block, taken ? condBr->getThenBranch () : condBr->getElseBranch ()));
+        } else if (op1.state == LatticeValue::Overdefined || op2.state == LatticeValue::Overdefined) {
+          edgeWorklist.push_back (std::make_pair (block, condBr->getThenBranch ()));
+          edgeWorklist.push_back (std::make_pair (block, condBr->getElseBranch ()));
+        }
+        continue;
+      }
+
+      getUsesAndDef (instr, instrUses, def);
+      if (def == nullptr)
+        continue;
+
+      if (isa<PHI> (instr)) {
+        value = LatticeValue ();
+        for (auto& blockIdPair : cast<PHI> (instr)->getCommandExprVector ()) {
+          if (executableEdges.count (std::make_pair (blockIdPair.first, block)) != 0)
+            value = meet (value, operandValue (blockIdPair.second, defined, values));
+        }
+      } else if (isa<Assignment> (instr)) {
+        Expression* input = cast<Assignment> (instr)->getInput ();
+
+        if (isa<Constant> (input) || isa<Identifier> (input))
+          value = operandValue (input, defined, values);
+      }
+
+      LatticeValue& old = values[def->getVersionedSymbol ()];
+
+      if (old.state == value.state && old.constant == value.constant)
+        continue;
+
+      old = value;
+      for (auto use : uses[def->getVersionedSymbol ()]) {
+        instrWorklist.push_back (use);
+      }
+    }
+  }
+
+  for (auto block : blocks) {
+    if (executable.count (block) == 0)
+      continue;
+
+    std::vector<Instruction*> phis, constants, instrs;
+
+    for (auto instr : block->getInstructions ()) {
+      std::vector<Identifier*> instrUses;
+      Identifier* def;
+
+      getUsesAndDef (instr, instrUses, def);
+      if (def != nullptr && values[def->getVersionedSymbol ()].state == LatticeValue::Known &&
+          (isa<PHI> (instr) || (isa<Assignment> (instr) && !isa<Constant> (cast<Assignment> (instr)->getInput ())))) {
+        constants.push_back (arenaNew<Assignment> (def, values[def->getVersionedSymbol ()].constant));
+        changed = true;
+        continue;
+      }
+
+      (isa<PHI> (instr) ? phis : instrs).push_back (instr);
+    }
+
+    ConditionalBranch* condBr = instrs.empty () ? nullptr : dyn_cast<ConditionalBranch> (instrs.back ());
+
+    if (condBr != nullptr && condBr->getThenBranch () != condBr->getElseBranch () &&
+        operandValue (condBr->getCondition ()->getOp1 (), defined, values).state == LatticeValue::Known &&
+        operandValue (condBr->getCondition ()->getOp2 (), defined, values).state == LatticeValue::Known) {
+      bool thenTaken = executableEdges.count (std::make_pair (block, condBr->getThenBranch ())) != 0;
+      BasicBlock* taken = thenTaken ? condBr->getThenBranch () : condBr->getElseBranch ();
+      BasicBlock* notTaken = thenTaken ? condBr->getElseBranch () : condBr->getThenBranch ();
+      std::vector<BasicBlock*>& preds = taken->getPredecessors ();
+
+      //The direct branch adds the edge to taken again.
+      removePredecessor (notTaken, block);
+      preds.erase (std::find (preds.begin (), preds.end (), block));
+      block->getSuccessors ().clear ();
+      instrs.back () = arenaNew<DirectBranch> (taken, block);
+      changed = true;
+    }
+
+    phis.insert (phis.end (), constants.begin (), constants.end ());
+    phis.insert (phis.end (), instrs.begin (), instrs.end ());
+    block->setInstructions (phis);
+  }
+
+  if (!changed)
+    return;
+
+  uses.clear ();
+  collectUses (program, uses, defined);
+  for (auto block : blocks) {
+    std::vector<Instruction*> instrs;
+
+    for (auto instr : block->getInstructions ()) {
+      Assignment* assign = dyn_cast<Assignment> (instr);
+
+      if (assign == nullptr || !isa<Constant> (assign->getInput ()) ||
+          uses.count (assign->getOutput ()->getVersionedSymbol ()) != 0)
+        instrs.push_back (instr);
+    }
+
+    block->setInstructions (instrs);
+  }
+}
+
+//Values live out of every block, where a PHI operand is only live out of
+//the predecessor it comes from, by a backward data flow.
+static void computeLiveOut (std::vector <BasicBlock*>& basicBlocks,
+                            std::unordered_map <BasicBlock*, BlockUseDef>& useDefs,
+                            std::unordered_map <BasicBlock*, std::unordered_set <VersionedSymbol>>& liveOut)
+{
+  std::unordered_map <BasicBlock*, std::unordered_set <VersionedSymbol>> liveIn;
+  std::vector <BasicBlock*> worklist (basicBlocks.begin (), basicBlocks.end ());
+  std::unordered_set <BasicBlock*> onWorklist (basicBlocks.begin (), basicBlocks.end ());
+  
+  //Blocks are taken from the back, so the first pass goes backwards.
+  while (worklist.empty () == false) {
+    BasicBlock* block = worklist.back ();
+    BlockUseDef& blockUD = useDefs[block];
+    std::unordered_set <VersionedSymbol> out, in;
+    
+    worklist.pop_back ();
+    onWorklist.erase (block);
+    
+    for (auto succ : block->getSuccessors ()) {
+      std::vector <VersionedSymbol>& phiUses = useDefs[succ].phiUses[block];
+      
+      out.insert (liveIn[succ].begin (), liveIn[succ].end ());
+      out.insert (phiUses.begin (), phiUses.end ());
+    }
+    
+    in = blockUD.upwardUses;
+    for (auto value : out) {
+      if (blockUD.blockDefs.count (value) == 0)
+        in.insert (value);
+    }
+    
+    liveOut[block] = out;
+    if (in != liveIn[block]) {
+      liveIn[block] = in;
+      for (auto pred : block->getPredecessors ()) {
+        if (onWorklist.insert (pred).second)
+          worklist.push_back (pred);
+      }
+    }
+  }
+}
+
+//The interference graph of allocateSlots, over the values defined in a
+//program numbered from 0. An edge can be added more than once.
+struct InterferenceGraph
+{
+  std::unordered_map <VersionedSymbol, int> numbers;
+  std::vector <VersionedSymbol> values;
+  std::vector <std::vector <int>> edges;
+  
+  void addValue (VersionedSymbol value)
+  {
+    if (numbers.insert (std::make_pair (value, (int)values.size ())).second) {
+      values.push_back (value);
+      edges.push_back (std::vector <int> ());
+    }
+  }
+  
+  //Returns -1 for a value not defined in the program, like input.
+  int getNumber (VersionedSymbol value)
+  {
+    auto iter = numbers.find (value);
+    
+    return iter == numbers.end () ? -1 : iter->second;
+  }
+  
+  void addEdge (int v1, int v2)
+  {
+    if (v1 == v2 || v1 == -1 || v2 == -1)
+      return;
+    
+    edges[v1].push_back (v2);
+    edges[v2].push_back (v1);
+  }
+};
+
+void allocateSlots (Program* program)
+{
+  /* Saved slot allocation.
+   * Every SSA value would have a key of its own in .saved, and the saved
+   * state serialized and parsed on every hop would only widen along the
+   * program. Instead values whose live ranges do not overlap share a slot.
+   * The value in a slot before is deleted where it dies by
+   * livenessAnalysis, which must not be after the next one is set.
+   * A value interferes with the values live where it is defined, and with
+   * the operands of its projection, which are read by the jq program
+   * setting it. Every block is walked backwards from the values live out
+   * of it to build the interference graph. The PHIs of a block are set
+   * together on every edge into it, so they interfere with each other and
+   * with the values live out of the predecessor, except their operand from
+   * it.
+   * Values are colored in dominator tree preorder with the smallest slot no
+   * interfering value has, or the slot of an operand or output of a PHI
+   * they are in if it is free, which makes the copy on that edge a no-op.
+   * A slot is a key of its own, see SymbolTable::getKey.
+   * */
+  std::vector <BasicBlock*>& basicBlocks = program->getBasicBlocks ();
+  std::unordered_map <BasicBlock*, BlockUseDef> useDefs;
+  std::unordered_map <BasicBlock*, std::unordered_set <VersionedSymbol>> liveOut;
+  InterferenceGraph graph;
+  //The values every value is an operand or output of a PHI with.
+  std::vector <std::vector <int>> phiRelated;
+  std::vector <int> slots;
+  //The value whose interfering values last took every slot.
+  std::vector <int> taken;
+  DominatorTree domTree (basicBlocks[0]);
+  std::vector <BasicBlock*> stack;
+  
+  for (auto block : basicBlocks) {
+    useDefs[block] = blockUseDef (block);
+    for (auto value : useDefs[block].blockDefs) {
+      graph.addValue (value);
+    }
+  }
+  computeLiveOut (basicBlocks, useDefs, liveOut);
+  phiRelated.resize (graph.values.size ());
+  
+  for (auto block : basicBlocks) {
+    BlockUseDef& blockUD = useDefs[block];
+    std::unordered_set <int> live;
+    const std::vector<Instruction*>& instrs = block->getInstructions ();
+    std::vector <PHI*> phis;
+    
+    for (auto value : liveOut[block]) {
+      live.insert (graph.getNumber (value));
+    }
+    
+    for (int i = instrs.size () - 1; i >= 0; i--) {
+      if (isa<PHI> (instrs[i])) {
+        phis.push_back (cast<PHI> (instrs[i]));
+        continue;
+      }
+      
+      //The operands of a projection are read in the same jq program that
+      //sets its value, they cannot be deleted in between.
+      for (auto def : blockUD.defs[i]) {
+        int value = graph.getNumber (def);
+        
+        for (auto other : live) {
+          graph.addEdge (value, other);
+        }
+        if (!isa<Call> (instrs[i])) {
+          for (auto use : blockUD.uses[i]) {
+            graph.addEdge (value, graph.getNumber (use));
+          }
+        }
+      }
+      
+      for (auto def : blockUD.defs[i]) {
+        live.erase (graph.getNumber (def));
+      }
+      for (auto use : blockUD.uses[i]) {
+        live.insert (graph.getNumber (use));
+      }
+    }
+    
+    //A value live out of a predecessor is still saved on the edge to the
+    //block, unless it is the operand copied to the PHI.
+    for (auto phi : phis) {
+      int value = graph.getNumber (phi->getOutput ()->getVersionedSymbol ());
+      
+      for (auto other : live) {
+        graph.addEdge (value, other);
+      }
+      for (auto other : phis) {
+        graph.addEdge (value, graph.getNumber (other->getOutput ()->getVersionedSymbol ()));
+      }
+      for (auto& blockIdPair : phi->getCommandExprVector ()) {
+        VersionedSymbol operandSymbol = blockIdPair.second->getVersionedSymbol ();
+        int operand = graph.getNumber (operandSymbol);
+        
+        for (auto other : liveOut[blockIdPair.first]) {
+          if (other != operandSymbol)
+            graph.addEdge (value, graph.getNumber (other));
+        }
+        if (operand != -1) {
+          phiRelated[value].push_back (operand);
+          phiRelated[operand].push_back (value);
+        }
+      }
+    }
+  }
+  
+  slots.assign (graph.values.size (), -1);
+  stack.push_back (domTree.getEntry ());
+  while (stack.empty () == false) {
+    BasicBlock* block = stack.back ();
+    BlockUseDef& blockUD = useDefs[block];
+    
+    stack.pop_back ();
+    for (auto& defs : blockUD.defs) {
+      for (auto def : defs) {
+        int value = graph.getNumber (def);
+        int slot = -1;
+        
+        for (auto other : graph.edges[value]) {
+          if (slots[other] != -1)
+            taken[slots[other]] = value;
+        }
+        for (auto other : phiRelated[value]) {
+          if (slots[other] != -1 && taken[slots[other]] != value) {
+            slot = slots[other];
+            break;
+          }
+        }
+        if (slot == -1) {
+          for (slot = 0; slot < (int)taken.size () && taken[slot] == value; slot++);
+          if (slot == (int)taken.size ())
+            taken.push_back (-1);
+        }
+        
+        slots[value] = slot;
+        SymbolTable::setSlot (def, slot);
+      }
+    }
+    
+    for (auto child : domTree.getChildren (block)) {
+      stack.push_back (child);
+    }
+  }
+}
+
+//Returns true if value is one of values or has the slot of one of them,
+//see allocateSlots.
+static bool sharesSlot (VersionedSymbol value, const std::vector <VersionedSymbol>& values)
+{
+  int slot = SymbolTable::getSlot (value);
+
+  for (auto other : values) {
+    if (other == value || (slot != -1 && SymbolTable::getSlot (other) == slot))
+      return true;
+  }
+  
+  return false;
+}
+
+void livenessAnalysis (Program* program) 
+{
+  /* Find the Instruction in every BasicBlock after which a saved value is
+   * dead, so that the backends can delete it from the saved state.
+   * A backward data flow gives the values live out of every block, where a
+   * PHI operand is only live out of the predecessor it comes from: the
+   * predecessor copies it into the PHI on its branch to the block, see
+   * BasicBlock::getPHICopyCode, so it is not read in the block itself. A
+   * value dies in a block after its last use there, or after its
+   * definition if it is never used, unless it is live out of the block. A
+   * value live out of a predecessor but not into a block, PHI operands
+   * included, dies on entry to the block, after the copies. It is not
+   * deleted when it is a PHI of the block or shares the slot of one, the
+   * edge into the block already set it to the PHI.
+   * */
+  Program::LivenessAnalysis idToLastDef;
+  std::vector <BasicBlock*>& basicBlocks = program->getBasicBlocks ();
+  std::unordered_map <BasicBlock*, BlockUseDef> useDefs;
+  std::unordered_map <BasicBlock*, std::unordered_set <VersionedSymbol>> liveOut;
+  std::unordered_set <VersionedSymbol> defined;
+  
+  for (auto block : basicBlocks) {
+    useDefs[block] = blockUseDef (block);
+    defined.insert (useDefs[block].blockDefs.begin (), useDefs[block].blockDefs.end ());
+  }
+  computeLiveOut (basicBlocks, useDefs, liveOut);
+  
+  for (auto block : basicBlocks) {
+    BlockUseDef& blockUD = useDefs[block];
+    std::unordered_set <VersionedSymbol> live = liveOut[block];
+    const std::vector<Instruction*>& instrs = block->getInstructions ();
+    std::vector <VersionedSymbol> phis;
+    
+    for (size_t i = 0; i < instrs.size () && isa<PHI> (instrs[i]); i++) {
+      phis.insert (phis.end (), blockUD.defs[i].begin (), blockUD.defs[i].end ());
+    }
+    
+    for (int i = instrs.size () - 1; i >= 0; i--) {
+      for (auto value : blockUD.defs[i]) {
+        if (live.count (value) == 0)
+          idToLastDef[value][block] = instrs[i];
+        live.erase (value);
+      }
+      if (isa<PHI> (instrs[i]))
+        continue;
+      for (auto value : blockUD.uses[i]) {
+        if (live.count (value) == 0 && defined.count (value) == 1)
+          idToLastDef[value][block] = instrs[i];
+        live.insert (value);
+      }
+    }
+    
+    //live is now the values live into block.
+    for (auto pred : block->getPredecessors ()) {
+      for (auto value : liveOut[pred]) {
+        if (live.count (value) == 0 && defined.count (value) == 1 && !sharesSlot (value, phis))
+          idToLastDef[value].insert (std::make_pair (block, (Instruction*)nullptr));
+      }
+    }
+  }
+  
+  program->setLivenessAnalysis (idToLastDef);
+}
+
+SavedStateStats savedStateStats (Program* program)
+{
+  /* Follow one path through the program, taking the least taken successor
+   * of every block so that each loop runs once, and count the values in
+   * the saved state after every instruction with and without deleting the
+   * dead ones.
+   * */
+  SavedStateStats stats = {0, 0, 0, 0, 0, 0};
+  std::unordered_set <VersionedSymbol> saved, live;
+  std::unordered_set <std::string> keys;
+  std::unordered_map <BasicBlock*, int> taken;
+  BasicBlock* block = program->getBasicBlocks ()[0];
+  
+  for (auto& valueToBlocks : program->getLivenessAnalysis ()) {
+    stats.deletes += valueToBlocks.second.size ();
+  }
+  
+  for (auto bb : program->getBasicBlocks ()) {
+    for (auto instr : bb->getInstructions ()) {
+      std::vector<Identifier*> uses;
+      Identifier* def;
+      
+      getUsesAndDef (instr, uses, def);
+      if (def != nullptr) {
+        stats.values++;
+        keys.insert (def->getIDWithVersion ());
+      }
+    }
+  }
+  stats.keys = keys.size ();
+  
+  while (block != nullptr) {
+    BlockUseDef blockUD = blockUseDef (block);
+    const std::vector<Instruction*>& instrs = block->getInstructions ();
+    BasicBlock* next = nullptr;
     
-    std::string finalString = "";
-    for (int i = 0; i < unionOfJSONs.size () - 1 ; i++) {
-      //For more than one use create a union of all fields.
-      finalString = finalString + unionOfJSONs[i] + " * ";
+    for (auto value : block->getDeadValues (nullptr)) {
+      live.erase (value);
     }
     
-    finalString = finalString + unionOfJSONs[unionOfJSONs.size() - 1];
-    requiredPatterns[id.first] = finalString;
+    for (size_t i = 0; i < instrs.size (); i++) {
+      for (auto value : blockUD.defs[i]) {
+        saved.insert (value);
+        live.insert (value);
+      }
+      if (isa<Return> (instrs[i]))
+        return stats;
+      for (auto value : block->getDeadValues (instrs[i])) {
+        live.erase (value);
+      }
+      
+      stats.edges++;
+      stats.savedValues += saved.size ();
+      stats.liveValues += live.size ();
+    }
+    
+    taken[block]++;
+    for (auto succ : block->getSuccessors ()) {
+      if (next == nullptr || taken[succ] < taken[next])
+        next = succ;
+    }
+    block = next;
+  }
+  
+  return stats;
+}
+
+/* The parts of a JSON value that are read, as a tree of field names and
+ * array indices. A node marked whole is read entirely, a node that is not
+ * whole and has no children is not read at all.
+ */
+struct JSONPathTree
+{
+  bool whole;
+  std::map <std::string, JSONPathTree> fields;
+  std::map <int, JSONPathTree> indices;
+  
+  JSONPathTree () : whole(false) {}
+  
+  void setWhole ()
+  {
+    whole = true;
+    fields.clear ();
+    indices.clear ();
+  }
+  
+  void addPath (const std::vector<Pattern*>& path, size_t from = 0)
+  {
+    if (whole)
+      return;
+    
+    if (from == path.size ()) {
+      setWhole ();
+      return;
+    }
+    
+    Pattern* pattern = path[from];
+    if (isa<FieldGetPattern> (pattern)) {
+      fields[cast<FieldGetPattern> (pattern)->getFieldName ()].addPath (path, from + 1);
+    } else if (isa<KeyGetPattern> (pattern)) {
+      fields[cast<KeyGetPattern> (pattern)->getKeyName ()].addPath (path, from + 1);
+    } else if (isa<ArrayIndexPattern> (pattern) && cast<ArrayIndexPattern> (pattern)->getIndex () >= 0) {
+      indices[cast<ArrayIndexPattern> (pattern)->getIndex ()].addPath (path, from + 1);
+    } else {
+      //Negative indices count from the end, keep the whole array.
+      setWhole ();
+    }
+  }
+  
+  //jq code building the read parts of value. Unread array elements are
+  //null, so that the read ones keep their index.
+  std::string convert (const std::string& value)
+  {
+    std::string code;
+    
+    //A value read both as an object and as an array is kept whole.
+    if (whole || (fields.empty () == indices.empty ()))
+      return value;
+    
+    if (!fields.empty ()) {
+      for (auto& field : fields) {
+        code += (code.empty () ? "{" : ", ");
+        code += R"(\")" + field.first + R"(\": )" + field.second.convert (value + "." + field.first);
+      }
+      
+      return code + "}";
+    }
+    
+    //The elements as a concatenation of arrays, long runs of unread
+    //elements are generated with range.
+    std::vector<std::string> arrays;
+    std::string elements;
+    int next = 0;
+    
+    for (auto& index : indices) {
+      int gap = index.first - next;
+      
+      if (gap > MAX_NULL_ELEMENTS) {
+        if (elements != "")
+          arrays.push_back ("[" + elements + "]");
+        arrays.push_back ("[range(" + std::to_string (gap) + ") | null]");
+        elements = "";
+      } else {
+        for (int i = 0; i < gap; i++) {
+          elements += (elements == "" ? "" : ", ") + std::string ("null");
+        }
+      }
+      
+      elements += (elements == "" ? "" : ", ") +
+        index.second.convert (value + "[" + std::to_string (index.first) + "]");
+      next = index.first + 1;
+    }
+    arrays.push_back ("[" + elements + "]");
+    
+    if (arrays.size () == 1)
+      return arrays[0];
+    
+    for (auto& array : arrays) {
+      code += (code.empty () ? "(" : " + ") + array;
+    }
+    
+    return code + ")";
+  }
+};
+
+//Adds to tree the parts of the value of id read by expr, path leads from
+//the call result to the value of id.
+static void addExpressionReadPaths (VersionedSymbol id, Expression* expr, const std::vector<Pattern*>& path,
+                                    JSONPathTree& tree)
+{
+  switch (expr->getKind ()) {
+    case IRNode::IdentifierKind:
+      if (cast<Identifier> (expr)->getVersionedSymbol () == id)
+        tree.addPath (path);
+      break;
+    case IRNode::PatternApplicationKind: {
+      Expression* base = expr;
+      
+      while (isa<PatternApplication> (base)) {
+        base = cast<PatternApplication> (base)->getIdentifier ();
+      }
+      
+      if (isa<Identifier> (base) && cast<Identifier> (base)->getVersionedSymbol () == id) {
+        std::vector<Pattern*> exprPath = path;
+        std::vector<Pattern*> patterns = cast<PatternApplication> (expr)->getAllPatterns ();
+        
+        exprPath.insert (exprPath.end (), patterns.begin (), patterns.end ());
+        tree.addPath (exprPath);
+      } else {
+        addExpressionReadPaths (id, base, path, tree);
+      }
+      break;
+    }
+    case IRNode::ConditionalKind:
+      addExpressionReadPaths (id, cast<Conditional> (expr)->getOp1 (), path, tree);
+      addExpressionReadPaths (id, cast<Conditional> (expr)->getOp2 (), path, tree);
+      break;
+    case IRNode::JSONObjectKind:
+      for (auto kv : cast<JSONObject> (expr)->getKeyValuePairs ()) {
+        addExpressionReadPaths (id, kv->getValue (), path, tree);
+      }
+      break;
+    case IRNode::ArrayKind:
+      for (auto element : cast<Array> (expr)->getExpressions ()) {
+        addExpressionReadPaths (id, element, path, tree);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+//Adds to tree the parts of the value of id read by its uses, path leads
+//from the call result to the value of id.
+static void addReadPaths (VersionedSymbol id, const std::vector<Pattern*>& path, UseDef& useDef,
+                          JSONPathTree& tree)
+{
+  for (auto use : useDef.getUses ()[id]) {
+    //Patterns applied to id and copies of it are followed to their uses.
+    if (isa<Assignment> (use)) {
+      Assignment* assign = cast<Assignment> (use);
+      Expression* input = assign->getInput ();
+      std::vector<Pattern*> inputPath = path;
+      
+      if (isa<PatternApplication> (input)) {
+        std::vector<Pattern*> patterns = cast<PatternApplication> (input)->getAllPatterns ();
+        
+        inputPath.insert (inputPath.end (), patterns.begin (), patterns.end ());
+        while (isa<PatternApplication> (input)) {
+          input = cast<PatternApplication> (input)->getIdentifier ();
+        }
+      }
+      
+      if (isa<Identifier> (input) && cast<Identifier> (input)->getVersionedSymbol () == id) {
+        addReadPaths (assign->getOutput ()->getVersionedSymbol (), inputPath, useDef, tree);
+        continue;
+      }
+    }
+    
+    //Patterns applied to id inside the expressions of an instruction read
+    //only their part of it. PHIs, stores and anything else read the whole
+    //value.
+    if (isa<Assignment> (use))
+      addExpressionReadPaths (id, cast<Assignment> (use)->getInput (), path, tree);
+    else if (isa<Call> (use))
+      addExpressionReadPaths (id, cast<Call> (use)->getArgument (), path, tree);
+    else if (isa<ConditionalBranch> (use))
+      addExpressionReadPaths (id, cast<ConditionalBranch> (use)->getCondition (), path, tree);
+    else if (isa<Return> (use))
+      addExpressionReadPaths (id, cast<Return> (use)->getReturnExpr (), path, tree);
+    else
+      tree.addPath (path);
+  }
+}
+
+void jsonLivenessAnalysis (Program* program)
+{
+  /* This analysis is like live analysis but works at the json key/value
+   * pairs instead of variables. Find if there are only specific 
+   * keys of a json returned from call is used and save only those keys in
+   * the state variable.
+   * Array indices are followed too, only the read elements of an array
+   * are saved, at their index.
+   */
+   
+  UseDef useDef;
+  UseDefVisitor visitor;
+  Program::JSONKeyAnalysis requiredPatterns;
+  useDef = visitor.getAllUseDef (program);
+  for (auto varAndDefs : useDef.getDefs ()) {
+    VersionedSymbol id = varAndDefs.first;
+    Instruction* def = varAndDefs.second;
+    JSONPathTree tree;
+    
+    //Consider only those defs which are from call instructions.
+    if (!isa<Call> (def)) {
+      continue;
+    }
+    
+    addReadPaths (id, std::vector<Pattern*> (), useDef, tree);
+    
+    //Values read whole or not read at all are saved whole.
+    if (tree.whole || (tree.fields.empty () && tree.indices.empty ()))
+      continue;
+    
+    requiredPatterns[id] = tree.convert (".input");
   }
   
   program->setJSONKeyAnalysis (requiredPatterns);
 }
 
-void optimize (Program* program)
+//Writes a JSON object mapping every key in .saved to the SSA names of the
+//values saved under it, one key per line in the order of the slots.
+static void writeKeyTable (Program* program, std::ostream& os)
+{
+  std::map <int, std::vector<std::string>> slots;
+  
+  for (auto block : program->getBasicBlocks ()) {
+    for (auto instr : block->getInstructions ()) {
+      std::vector<Identifier*> uses;
+      Identifier* def;
+      
+      getUsesAndDef (instr, uses, def);
+      if (def != nullptr && SymbolTable::getSlot (def->getVersionedSymbol ()) != -1)
+        slots[SymbolTable::getSlot (def->getVersionedSymbol ())].push_back (
+          SymbolTable::getVersionedName (def->getVersionedSymbol ()));
+    }
+  }
+  
+  os << "{";
+  for (auto iter = slots.begin (); iter != slots.end (); iter++) {
+    os << (iter == slots.begin () ? "\n" : ",\n") << "  " <<
+      jsonString ("s" + std::to_string (iter->first)) << ": [";
+    for (size_t i = 0; i < iter->second.size (); i++) {
+      os << (i == 0 ? "" : ", ") << jsonString (iter->second[i]);
+    }
+    os << "]";
+  }
+  os << "\n}\n";
+}
+
+void optimize (Program* program, const std::unordered_set<std::string>& pureActions, bool compactKeys)
 {
+  //simplifyCFG cleans up after every pass changing blocks: the branches
+  //folded by constant propagation, and the blocks emptied by the passes
+  //moving instructions out of them.
+  sparseConditionalConstantPropagation (program);
+  simplifyCFG (program, true);
+  loopInvariantCodeMotion (program);
+  globalValueNumbering (program, pureActions);
+  codeSinking (program, pureActions);
+  simplifyCFG (program);
+  if (compactKeys)
+    allocateSlots (program);
   livenessAnalysis (program);
   jsonLivenessAnalysis (program);
 }
 
-void convertToWhiskCommands (ComplexCommand& cmds, std::ostream& out, bool to_optimize, bool print_ssa)
+void convertToWhiskCommands (ComplexCommand& cmds, std::ostream& out, const CompilerOptions& options)
 {
-  Program* program = convertToSSA (&cmds, print_ssa);
-  if (to_optimize) {
-    optimize (program);
+  //SSA and backend nodes live only until the commands are generated, the
+  //AST stays with whoever built it.
+  CompilationArena arena;
+  Program* program = convertToSSA (&cmds, options.printSSA);
+  if (options.optimize) {
+    optimize (program, options.pureActions, options.compactKeys);
   }
   std::vector <WhiskSequence*> seqs;
   WhiskProgram* p = (WhiskProgram*)program->convert (program, seqs);
-  p->generateCommand (out);
+  int removed = 0;
+  if (options.optimize) {
+    removed = p->fuseProjections (options.foldResultProjections);
+  }
+  
+  DeploymentState state;
+  bool incremental = options.previousState != "" || options.newState != "";
+  if (options.previousState != "") {
+    std::ifstream previous (options.previousState);
+    
+    //Without a previous state everything is deployed.
+    if (previous.is_open () && !state.read (previous)) {
+      fprintf (stderr, "Invalid deployment state '%s'\n", options.previousState.c_str ());
+      abort ();
+    }
+  }
+  if (incremental) {
+    p->setDeploymentState (&state);
+  }
+  
+  if (options.manifest) {
+    p->generateManifest (out);
+    if (incremental) {
+      for (auto& orphan : state.getOrphans ()) {
+        out << "{\"orphan\": " << jsonString (orphan) << "}\n";
+      }
+    }
+  } else {
+    std::ostringstream commands;
+    
+    if (options.optimize) {
+      SavedStateStats stats = savedStateStats (program);
+      
+      out << "# Projection fusion removed " << removed << " action hops" << std::endl;
+      out << "# Saved state GC deletes " << stats.deletes << " dead values, " <<
+        (double) (stats.savedValues - stats.liveValues) / std::max (stats.edges, 1) <<
+        " fewer saved values per edge" << std::endl;
+      out << "# " << stats.values << " saved values share " << stats.keys << " keys" << std::endl;
+    }
+    p->generateCommand (incremental ? commands : out);
+    if (incremental) {
+      out << "# " << state.getNumberOfActions () - state.getNumberOfUnchanged () << " of " <<
+        state.getNumberOfActions () << " actions changed since the previous deployment" << std::endl;
+      out << commands.str ();
+      for (auto& orphan : state.getOrphans ()) {
+        out << "# Orphaned: " << WHISK_CLI_PATH << " " << WHISK_CLI_ARGS << " action delete " << orphan << std::endl;
+      }
+    }
+  }
+  
+  if (options.optimize && options.compactKeys && options.keyTable != "") {
+    std::ofstream table (options.keyTable);
+    
+    if (!table.is_open ()) {
+      fprintf (stderr, "Cannot write key table '%s'\n", options.keyTable.c_str ());
+      abort ();
+    }
+    writeKeyTable (program, table);
+  }
+  
+  if (options.newState != "") {
+    std::ofstream next (options.newState);
+    
+    if (!next.is_open ()) {
+      fprintf (stderr, "Cannot write deployment state '%s'\n", options.newState.c_str ());
+      abort ();
+    }
+    state.write (next);
+  }
 }
 
-int main () {}
+void convertToWhiskCommands (ComplexCommand& cmds, std::ostream& out, bool to_optimize, bool print_ssa)
+{
+  CompilerOptions options;
+  
+  options.optimize = to_optimize;
+  options.printSSA = print_ssa;
+  convertToWhiskCommands (cmds, out, options);
+}
@@ -1,3 +1,5 @@
+#include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "ast.h"
@@ -6,6 +8,33 @@
 #ifndef __DRIVER_H__
 #define __DRIVER_H__
 
+class Program;
+
+//Front end and optimizer entry points, exposed separately so that the
+//phases can be timed on their own.
+Program* convertToSSA (ComplexCommand* cmd, bool print_ssa = false);
+//Calls to pureActions with the same argument run once. With compactKeys
+//values are saved under short keys, shared when they are not live at once.
+void optimize (Program* program,
+               const std::unordered_set<std::string>& pureActions = std::unordered_set<std::string> (),
+               bool compactKeys = true);
+
+//Values in the saved state summed over the instructions of one path
+//through an optimized program, see savedStateStats.
+struct SavedStateStats
+{
+  int deletes;
+  int edges;
+  long savedValues;
+  long liveValues;
+  //Values defined in the program and the keys they are saved under, see
+  //allocateSlots.
+  int values;
+  int keys;
+};
+
+SavedStateStats savedStateStats (Program* program);
+
 class Converter
 {
 public:
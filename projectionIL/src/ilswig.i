@@ -4,7 +4,10 @@
 #include "driver.h"
 #include "utils.h"
 #include "whisk_action.h"
+#include "arena.cpp"
 #include "ast.cpp"
+#include "dominators.cpp"
+#include "loops.cpp"
 #include "driver.cpp"
 %}
 
@@ -15,6 +18,18 @@
 %include "utils.h"
 %include "whisk_action.h"
 
+//Nodes created by the AST operators, like X["a"] == 1, are allocated with
+//arenaNew. Keep a CompilationArena alive while building and compiling a
+//program so that they are freed with it instead of leaking.
+class CompilationArena
+{
+public:
+  CompilationArena ();
+  ~CompilationArena ();
+  size_t getPeakBytes () const;
+  static size_t getLastPeakBytes ();
+};
+
 namespace std {
 %template(VectorSimpleCommand) vector<SimpleCommand*>;
 }
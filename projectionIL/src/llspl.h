@@ -51,6 +51,10 @@ class LLSPLProjection : public ServerlessProjection
 {
 public:
 
+  LLSPLProjection (std::string _code) : ServerlessProjection (_code) 
+  {
+  }
+  
   LLSPLProjection (std::string name, std::string _code) : ServerlessProjection (name, _code) 
   {
   }
@@ -68,7 +72,7 @@ private:
   LLSPLProjection* proj;
   
 public:
-  LLSPLDirectBranch (std::string _target) : target(_target)
+  LLSPLDirectBranch (std::string _target) : ServerlessApp (DirectBranchKind), target(_target)
   {
     //proj = new LLSPLProjection ("Proj_DirectBranch_" +gen_random_str (WHISK_PROJ_NAME_LENGTH), 
     //                   R"(. * {\"action\":\")" + target+R"(\"})"); //TODO: Wrap correctly in app.
@@ -93,11 +97,11 @@ public:
 class LLSPLFork : public ServerlessFork
 {
 public:
-  LLSPLFork (std::string name, std::string _innerActionName, std::string _returnName) : ServerlessFork (name, _innerActionName, _returnName, "")
+  LLSPLFork (std::string _innerActionName, std::string _returnName) : ServerlessFork (_innerActionName, _returnName, "")
   {
   }
   
-  LLSPLFork (std::string name, ServerlessAction* _innerAction, std::string _returnName) : ServerlessFork (name, _innerAction, _returnName, "")
+  LLSPLFork (ServerlessAction* _innerAction, std::string _returnName) : ServerlessFork (_innerAction, _returnName, "")
   {
   }
   
@@ -125,11 +129,14 @@ private:
 
 public:
   LLSPLProjForkPair (LLSPLProjection* _proj, LLSPLFork* _fork):
-    LLSPLAction ("ProjForkPair_" + gen_random_str (WHISK_FORK_NAME_LENGTH)),
+    LLSPLAction ("ProjForkPair_" + gen_hash_str (_proj->getProjCode () + _fork->getInnerActionName (), WHISK_FORK_NAME_LENGTH),
+                 ProjForkPairKind),
     fork(_fork), proj(_proj)
   {
   }
   
+  static bool classof (const ServerlessAction* action) {return action->getKind () == ProjForkPairKind;}
+  
   virtual void print ()
   {
     proj->print ();
@@ -156,10 +163,12 @@ protected:
   
 public:
   LLSPLIf (std::string _name, std::string _cond, LLSPLAction* _thenAction, LLSPLAction* _elseAction) : 
-    ServerlessAction (_name), cond(_cond), thenAction(_thenAction), elseAction(_elseAction)
+    ServerlessAction (_name, IfKind), cond(_cond), thenAction(_thenAction), elseAction(_elseAction)
   {
   }
   
+  static bool classof (const ServerlessAction* action) {return action->getKind () == IfKind;}
+  
   virtual void print ()
   {
     fprintf (stdout, "If (");
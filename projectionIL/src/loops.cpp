@@ -0,0 +1,163 @@
+#include "loops.h"
+#include "ssa.h"
+
+#include <utility>
+
+LoopInfo::LoopInfo (DominatorTree& _domTree) : domTree(_domTree)
+{
+  const std::vector<BasicBlock*>& rpo = domTree.getReversePostOrder ();
+  //The outermost loop found so far around a loop, with path compression.
+  std::unordered_map <NaturalLoop*, NaturalLoop*> outermost;
+
+  for (int i = (int)rpo.size () - 1; i >= 0; i--) {
+    BasicBlock* header = rpo[i];
+    std::vector<BasicBlock*> worklist;
+    NaturalLoop* loop;
+
+    for (auto pred : header->getPredecessors ()) {
+      if (domTree.dominates (header, pred))
+        worklist.push_back (pred);
+    }
+
+    if (worklist.empty ())
+      continue;
+
+    loops.push_back (NaturalLoop {header, worklist, nullptr, 0, 0});
+    loop = &loops.back ();
+    outermost[loop] = loop;
+
+    while (worklist.empty () == false) {
+      BasicBlock* bb = worklist.back ();
+      auto iter = innermost.find (bb);
+
+      worklist.pop_back ();
+      if (iter == innermost.end ()) {
+        innermost[bb] = loop;
+        if (bb == header)
+          continue;
+
+        for (auto pred : bb->getPredecessors ()) {
+          if (domTree.isReachable (pred))
+            worklist.push_back (pred);
+        }
+        continue;
+      }
+
+      //A block of an inner loop, continue from the predecessors of its
+      //header outside of it.
+      NaturalLoop* inner = findOutermost (iter->second, outermost);
+
+      if (inner == loop)
+        continue;
+
+      inner->parent = loop;
+      outermost[inner] = loop;
+      for (auto pred : inner->header->getPredecessors ()) {
+        if (domTree.isReachable (pred) && !domTree.dominates (inner->header, pred))
+          worklist.push_back (pred);
+      }
+    }
+  }
+
+  numberTree ();
+}
+
+NaturalLoop* LoopInfo::findOutermost (NaturalLoop* loop, std::unordered_map <NaturalLoop*, NaturalLoop*>& outermost)
+{
+  NaturalLoop* root = loop;
+
+  while (outermost[root] != root) {
+    root = outermost[root];
+  }
+
+  while (outermost[loop] != root) {
+    NaturalLoop* next = outermost[loop];
+
+    outermost[loop] = root;
+    loop = next;
+  }
+
+  return root;
+}
+
+void LoopInfo::numberTree ()
+{
+  std::unordered_map <NaturalLoop*, std::vector<NaturalLoop*>> children;
+  std::vector <std::pair <NaturalLoop*, int>> stack;
+  int counter = 0;
+
+  for (auto& loop : loops) {
+    if (loop.parent != nullptr)
+      children[loop.parent].push_back (&loop);
+    else
+      stack.push_back (std::make_pair (&loop, -1));
+  }
+
+  while (stack.empty () == false) {
+    NaturalLoop* loop = stack.back ().first;
+    int& next = stack.back ().second;
+
+    if (next == -1) {
+      loop->treeIn = counter++;
+      next = 0;
+    }
+
+    if (next == (int)children[loop].size ()) {
+      loop->treeOut = counter++;
+      stack.pop_back ();
+      continue;
+    }
+
+    stack.push_back (std::make_pair (children[loop][next++], -1));
+  }
+}
+
+NaturalLoop* LoopInfo::getLoopFor (BasicBlock* bb)
+{
+  auto iter = innermost.find (bb);
+
+  if (iter == innermost.end ())
+    return nullptr;
+
+  return iter->second;
+}
+
+bool LoopInfo::contains (NaturalLoop* loop, BasicBlock* bb)
+{
+  NaturalLoop* inner = getLoopFor (bb);
+
+  if (inner == nullptr)
+    return false;
+
+  return loop->treeIn <= inner->treeIn && inner->treeOut <= loop->treeOut;
+}
+
+std::vector<BasicBlock*> LoopInfo::getBlocks (NaturalLoop* loop)
+{
+  std::vector<BasicBlock*> blocks;
+
+  for (auto bb : domTree.getReversePostOrder ()) {
+    if (contains (loop, bb))
+      blocks.push_back (bb);
+  }
+
+  return blocks;
+}
+
+BasicBlock* LoopInfo::getPreheader (NaturalLoop* loop)
+{
+  BasicBlock* preheader = nullptr;
+
+  for (auto pred : loop->header->getPredecessors ()) {
+    if (contains (loop, pred) || !domTree.isReachable (pred))
+      continue;
+    if (preheader != nullptr && preheader != pred)
+      return nullptr;
+    preheader = pred;
+  }
+
+  if (preheader == nullptr || preheader->getSuccessors ().size () != 1)
+    return nullptr;
+
+  return preheader;
+}
@@ -0,0 +1,60 @@
+#include <deque>
+#include <vector>
+#include <unordered_map>
+
+#include "dominators.h"
+
+#ifndef __LOOPS_H__
+#define __LOOPS_H__
+
+class BasicBlock;
+
+/* Natural loops of the blocks reachable from an entry block.
+ *
+ * An edge latch -> header is a back edge if header dominates latch. The
+ * natural loop of a header is the header and every block reaching one of
+ * its latches without going through the header. Loops are either disjoint
+ * or nested, a loop's parent is the smallest loop containing it.
+ *
+ * Headers are visited from the last in reverse postorder, so inner loops
+ * are found first, and the search backwards from the latches of a loop
+ * steps over the inner loops it meets from their header. Every block is
+ * mapped to its innermost loop only, and the loop tree is numbered like the
+ * dominator tree so that containment is an interval check.
+ */
+struct NaturalLoop
+{
+  BasicBlock* header;
+  std::vector<BasicBlock*> latches;
+  NaturalLoop* parent;
+  //Pre and post order numbers of the loop tree walk.
+  int treeIn;
+  int treeOut;
+};
+
+class LoopInfo
+{
+private:
+  DominatorTree& domTree;
+  //Inner loops before the loops containing them.
+  std::deque<NaturalLoop> loops;
+  std::unordered_map <BasicBlock*, NaturalLoop*> innermost;
+
+  NaturalLoop* findOutermost (NaturalLoop* loop, std::unordered_map <NaturalLoop*, NaturalLoop*>& outermost);
+  void numberTree ();
+
+public:
+  LoopInfo (DominatorTree& domTree);
+
+  std::deque<NaturalLoop>& getLoops () {return loops;}
+  //Returns nullptr for a block outside of every loop.
+  NaturalLoop* getLoopFor (BasicBlock* bb);
+  bool contains (NaturalLoop* loop, BasicBlock* bb);
+  //The blocks of loop in reverse postorder, the header first.
+  std::vector<BasicBlock*> getBlocks (NaturalLoop* loop);
+  //The only reachable predecessor of the header outside of the loop, if
+  //its only successor is the header, nullptr otherwise.
+  BasicBlock* getPreheader (NaturalLoop* loop);
+};
+
+#endif /*__LOOPS_H__*/
@@ -2,6 +2,7 @@
 
 from ilswig import *
 import ilswig
+arena = ilswig.CompilationArena()
 X1 = ilswig.JSONIdentifier("X1")
 X2 = ilswig.JSONIdentifier("X2")
 _input = ilswig.Input()
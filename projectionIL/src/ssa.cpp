@@ -1,16 +1,20 @@
 #include "ssa.h"
 #include "ast.h"
 
+#include <algorithm>
 #include <unordered_map>
 
 int BasicBlock::numberOfBasicBlocks = 0;
-std::unordered_map <std::string, std::vector <Identifier*> > Identifier::identifiers;
+std::vector <std::vector <Identifier*> > Identifier::identifiers;
+std::unordered_map <std::string, Symbol> SymbolTable::symbols;
+std::deque <std::string> SymbolTable::names;
+std::unordered_map <VersionedSymbol, int> SymbolTable::slots;
 
 void Identifier::setCallStmt(Call* _callStmt) 
 {
   if (callStmt != nullptr) {
     fprintf (stderr, "Identifier '%s' already assigned to action '%s', cannot be assigned to action '%s'\n",
-             identifier.c_str(), callStmt->getActionName().c_str (), _callStmt->getActionName ().c_str());
+             getID ().c_str(), callStmt->getActionName().c_str (), _callStmt->getActionName ().c_str());
     abort ();
   }
   
@@ -30,7 +34,7 @@ std::string Identifier::convert ()
   }*/
   
   //if (callStmts.size() == 1) {
-    return R"(. * {\"input\":.saved.output_)"+callStmt->getForkName ()+"}";
+    return jqAssignment (".input", ".saved.output_" + callStmt->getForkName ());
   
   /*else {
     std::string output_key = "output_"+_callStmt;
@@ -38,3 +42,160 @@ std::string Identifier::convert ()
     return ". * {\"saved\": { \"" + identifier +"\":"+output + "}}";
   }*/
 }
+
+const std::vector<VersionedSymbol>& BasicBlock::getDeadValues (Instruction* instr)
+{
+  static const std::vector<VersionedSymbol> none;
+  auto iter = deadValues.find (instr);
+  
+  return iter == deadValues.end () ? none : iter->second;
+}
+
+std::string BasicBlock::getDeleteCode (const std::vector<VersionedSymbol>& values)
+{
+  std::vector<std::string> paths;
+  std::string code;
+  
+  if (values.empty ())
+    return "";
+  
+  for (auto value : values) {
+    paths.push_back (".saved." + SymbolTable::getKey (value));
+  }
+  //Sorted, so that the code and the name of the projection are stable.
+  //Values sharing a slot are deleted once.
+  std::sort (paths.begin (), paths.end ());
+  paths.erase (std::unique (paths.begin (), paths.end ()), paths.end ());
+  
+  for (auto& path : paths) {
+    code += (code.empty () ? "del(" : ", ") + path;
+  }
+  
+  return code + ")";
+}
+
+//A parallel copy, every value is read from the input of the projection
+//before any PHI is set, as the right hand side of += is.
+std::string BasicBlock::getPHICopyCode (BasicBlock* pred)
+{
+  std::string code;
+  
+  for (auto cmd : cmds) {
+    if (!isa<PHI> (cmd))
+      continue;
+    
+    PHI* phi = cast<PHI> (cmd);
+    Identifier* incoming = phi->getIncoming (pred);
+    
+    //Already there when both share a slot.
+    if (!isa<Input> (incoming) && incoming->getIDWithVersion () == phi->getOutput ()->getIDWithVersion ())
+      continue;
+    code += (code.empty () ? "" : ", ") + std::string (R"(\")") + phi->getOutput ()->getIDWithVersion () +
+      R"(\": )" + incoming->convert ();
+  }
+  
+  if (code.empty ())
+    return "";
+  
+  return ".saved += {" + code + "}";
+}
+
+LLSPLAction* BasicBlock::convertToLLSPL (std::vector<LLSPLSequence*>& basicBlockCollection)
+{
+  std::string deleteCode;
+  if (converted) {
+    return (LLSPLSequence*)seq;
+  }
+   
+  converted = true;
+  
+  seq = arenaNew<LLSPLSequence> (getActionName ());
+  basicBlockCollection.push_back ((LLSPLSequence*)seq);
+  
+  deleteCode = getDeleteCode (getDeadValues (nullptr));
+  if (deleteCode != "") {
+    seq->appendAction (arenaNew<LLSPLProjection> (deleteCode));
+  }
+  
+  for (auto cmd : cmds) {
+    LLSPLAction* act;
+    act = cmd->convertToLLSPL (basicBlockCollection);
+    if (act != nullptr) {
+      seq->appendAction (act);
+    }
+    
+    //Nothing runs after a Return.
+    deleteCode = getDeleteCode (getDeadValues (cmd));
+    if (deleteCode != "" && !isa<Return> (cmd)) {
+      seq->appendAction (arenaNew<LLSPLProjection> (deleteCode));
+    }
+  }
+  
+  return seq;
+}
+
+WhiskAction* BasicBlock::convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection)
+{
+  std::string deleteCode;
+  if (converted) {
+    return (WhiskSequence*)seq;
+  }
+   
+  converted = true;
+  
+  seq = arenaNew<WhiskSequence> ();
+  basicBlockCollection.push_back ((WhiskSequence*)seq);
+  
+  //Dead values are deleted in projections of their own, fuseProjections
+  //composes them with the neighbouring ones.
+  deleteCode = getDeleteCode (getDeadValues (nullptr));
+  if (deleteCode != "") {
+    seq->appendAction (arenaNew<WhiskProjection> (deleteCode));
+  }
+  
+  for (auto cmd : cmds) {
+    WhiskAction* act;
+    std::vector<VersionedSymbol> deadAfter;
+    
+    //PHIs are set by the branches of the predecessors, see getPHICopyCode.
+    if (isa<PHI> (cmd))
+      act = nullptr;
+    else
+      act = cmd->convert (program, basicBlockCollection);
+    if (act != nullptr)
+      seq->appendAction (act);
+    if (isa<Return> (cmd))
+      continue;
+    
+    deadAfter = getDeadValues (cmd);
+    if (isa<Call> (cmd) && !deadAfter.empty ()) {
+      //The arguments of a call are dead once they are in the input of the
+      //fork, delete them before the call so they are not passed along.
+      VersionedSymbol ret = cast<Call> (cmd)->getReturnValue ()->getVersionedSymbol ();
+      WhiskProjForkPair* pair = cast<WhiskProjForkPair> (act);
+      std::vector<VersionedSymbol> args;
+      
+      for (auto value : deadAfter) {
+        if (value != ret)
+          args.push_back (value);
+      }
+      
+      if (!args.empty ()) {
+        std::vector<WhiskProjection*> parts = {pair->getProjection (),
+                                               arenaNew<WhiskProjection> (getDeleteCode (args))};
+        pair->setProjection (arenaNew<WhiskProjection> (parts));
+      }
+      
+      if (args.size () == deadAfter.size ())
+        continue;
+      deadAfter = {ret};
+    }
+    
+    deleteCode = getDeleteCode (deadAfter);
+    if (deleteCode != "") {
+      seq->appendAction (arenaNew<WhiskProjection> (deleteCode));
+    }
+  }
+  
+  return seq;
+}
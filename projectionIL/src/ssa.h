@@ -10,6 +10,7 @@
 #include "utils.h"
 #include "ast.h"
 #include "llspl.h"
+#include "symbols.h"
 
 #ifndef __SSA_H__
 #define __SSA_H__
@@ -54,9 +55,57 @@ class Transformation;
 
 class IRNode
 {
+public:
+  //Concrete node kinds, see ASTNode::NodeKind. Kinds of a class hierarchy
+  //are contiguous so that classof of an abstract class is a range check.
+  enum NodeKind
+  {
+    IdentifierKind,
+    InputKind,
+    PointerKind,
+    ConditionalKind,
+    NumberKind,
+    StringKind,
+    BooleanKind,
+    ArrayKind,
+    JSONObjectKind,
+    PatternApplicationKind,
+    JSONKeyValuePairKind,
+    BasicBlockKind,
+    CallKind,
+    LoadPointerKind,
+    StorePointerKind,
+    ReturnKind,
+    TransformationKind,
+    AssignmentKind,
+    LetKind,
+    ConditionalBranchKind,
+    PHIKind,
+    DirectBranchKind,
+    BackwardBranchKind,
+    ProgramKind,
+    FieldGetPatternKind,
+    ArrayIndexPatternKind,
+    KeyGetPatternKind,
+    PatternsKind,
+    
+    FirstExpressionKind = IdentifierKind,
+    LastExpressionKind = PatternApplicationKind,
+    FirstConstantKind = NumberKind,
+    LastConstantKind = BooleanKind,
+    FirstInstructionKind = BasicBlockKind,
+    LastInstructionKind = BackwardBranchKind,
+    FirstPatternKind = FieldGetPatternKind,
+    LastPatternKind = PatternsKind
+  };
+  
+private:
+  const NodeKind kind;
+  
 protected:
-  IRNode () {}
+  IRNode (NodeKind _kind) : kind(_kind) {}
 public:
+  NodeKind getKind () const {return kind;}
   virtual void print (std::ostream& os) = 0;
   virtual void accept(IRNodeVisitor* visitor, IRNodeVisitorArg arg) = 0;
   virtual ~IRNode () {}
@@ -64,7 +113,15 @@ public:
 
 class Expression : public IRNode
 {
+protected:
+  Expression (NodeKind _kind) : IRNode (_kind) {}
+  
 public:
+  static bool classof (const IRNode* node)
+  {
+    return node->getKind () >= FirstExpressionKind && node->getKind () <= LastExpressionKind;
+  }
+  
   virtual std::string convert () = 0;
   virtual std::string convertToLLSPL () = 0;
   virtual void accept(IRNodeVisitor* visitor, IRNodeVisitorArg arg) = 0;
@@ -73,39 +130,60 @@ public:
 class Identifier : public Expression
 {
 private:
-  std::string identifier;
+  Symbol symbol;
   Call* callStmt;
-  static std::unordered_map <std::string, std::vector <Identifier*> > identifiers;
+  //Indexed by Symbol
+  static std::vector <std::vector <Identifier*> > identifiers;
   int version;
   
 public:
   Identifier (std::string id, int _version, Call* _callStmt) : 
-    identifier(id), version (_version), callStmt (_callStmt)
+    Identifier (SymbolTable::intern (id), _version, _callStmt, IdentifierKind) {}
+  Identifier (std::string id, int _version) : Identifier (id, _version, nullptr) {}
+  Identifier (std::string id) : Identifier(id, -1) {}
+  Identifier (Symbol _symbol, int _version) : 
+    Identifier (_symbol, _version, nullptr, IdentifierKind) {}
+  Identifier (Symbol _symbol) : Identifier (_symbol, -1) {}
+  
+protected:
+  Identifier (Symbol _symbol, int _version, Call* _callStmt, NodeKind _kind) : 
+    Expression (_kind), symbol (_symbol), callStmt(_callStmt), version (_version)
   {
-    if (identifiers.find(id) == identifiers.end ())
-      identifiers [id] = std::vector <Identifier*> ();
-    identifiers [id].push_back (this);
+    if (identifiers.size () <= symbol)
+      identifiers.resize (symbol + 1);
+    identifiers [symbol].push_back (this);
   }
   
-  Identifier (std::string id, int _version) : identifier(id), 
-                                  version (_version), callStmt(nullptr)
+public:
+  static bool classof (const IRNode* node)
   {
-    if (identifiers.find(id) == identifiers.end ())
-      identifiers [id] = std::vector <Identifier*> ();
-    identifiers [id].push_back (this);
+    return node->getKind () == IdentifierKind || node->getKind () == InputKind;
+  }
+  
+  //Identifiers are owned by the compilation arena, forget them (and their
+  //symbols) once it is gone.
+  static void resetIdentifiers ()
+  {
+    identifiers.clear ();
+    SymbolTable::reset ();
   }
-  Identifier (std::string id) : Identifier(id, -1) {}
   
   void setVersion (int _version) {version = _version;}
+  //Makes a use name value instead, see globalValueNumbering.
+  void replaceWith (const Identifier* value) {symbol = value->symbol; version = value->version;}
   int getVersion () {return version;}
   void setCallStmt(Call* _callStmt);
   virtual std::string convert ();
   virtual std::string convertToLLSPL () {return convert ();}
-  std::string getID () const {return identifier;}
-  std::string getIDWithVersion () const {return identifier+"_"+std::to_string (version);}
+  Symbol getSymbol () const {return symbol;}
+  VersionedSymbol getVersionedSymbol () const {return makeVersionedSymbol (symbol, version);}
+  const std::string& getID () const {return SymbolTable::getName (symbol);}
+  //The key in .saved, only for code generation, analyses use
+  //getVersionedSymbol.
+  std::string getIDWithVersion () const {return SymbolTable::getKey (getVersionedSymbol ());}
   virtual void print (std::ostream& os)
   {
-    os << identifier+"_"+std::to_string(version);
+    os << getID () << "_" << version;
   }
   
   virtual void accept(IRNodeVisitor* visitor, IRNodeVisitorArg arg)
@@ -117,9 +195,15 @@ public:
 class Instruction : public IRNode
 {
 protected:
-  Instruction () {}
+  Instruction (NodeKind _kind) : IRNode (_kind) {}
   
 public:
+  static bool classof (const IRNode* node)
+  {
+    return node->getKind () >= FirstInstructionKind && node->getKind () <= LastInstructionKind;
+  }
+  
+
   virtual ~Instruction () {}
   virtual std::string getActionName () = 0;
   virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection) = 0;
@@ -150,56 +234,35 @@ class BasicBlock : public Instruction
 {
 protected:
   std::vector<Instruction*> cmds;
-  std::string actionName;
   bool converted;
   ServerlessSequence* seq;
   std::string basicBlockName;
   std::vector <BasicBlock*> predecessors;
   std::vector <BasicBlock*> successors;
-  std::unordered_map <Identifier*, LoadPointer*> reads;
-  std::unordered_map <Identifier*, StorePointer*> writes;
+  //Saved values dead after an instruction of this block, or on entry to
+  //the block for nullptr. See Program::LivenessAnalysis.
+  std::unordered_map <Instruction*, std::vector<VersionedSymbol>> deadValues;
   //std::unordered_map <Identifier*, UseDef*> useDef;
   
 public:
   static int numberOfBasicBlocks;
 
-  BasicBlock(std::vector<Instruction*> _cmds): Instruction (), 
+  BasicBlock(std::vector<Instruction*> _cmds): Instruction (BasicBlockKind), 
                                                     cmds(_cmds)
   {
-    actionName = "Sequence_" + gen_random_str (WHISK_SEQ_NAME_LENGTH);
     converted = false;
     basicBlockName = "#" + std::to_string (numberOfBasicBlocks);
     numberOfBasicBlocks++;
   }
   
-  BasicBlock(): Instruction ()
+  BasicBlock(): Instruction (BasicBlockKind)
   {
     converted = false;
-    actionName = "Sequence_" + gen_random_str (WHISK_SEQ_NAME_LENGTH);
     basicBlockName = "#" + std::to_string (numberOfBasicBlocks);
     numberOfBasicBlocks++;
   }
   
-  bool hasWrite (Identifier* v)
-  {
-    for (auto iter : writes) {
-      if (iter.first->getID () == v->getID ()) {
-        if (iter.second == nullptr) 
-          return false;
-        return true;
-      }
-        
-    }
-    
-    return false;
-  }
-  
-  void insertRead (Identifier* v, LoadPointer* ptr) {reads[v] = ptr;}
-  void insertWrite (Identifier* v, StorePointer* ptr) {writes[v] = ptr;}
-  void insertRead (Identifier* v) {reads[v] = nullptr;}
-  void insertWrite (Identifier* v) {writes[v] = nullptr;}
-  std::unordered_map <Identifier*, LoadPointer*> getReads () {return reads;}
-  std::unordered_map <Identifier*, StorePointer*> getWrites () {return writes;}
+  static bool classof (const IRNode* node) {return node->getKind () == BasicBlockKind;}
   
   void appendInstruction (Instruction* c)
   {
@@ -226,56 +289,23 @@ public:
   std::vector <BasicBlock*>& getPredecessors () {return predecessors;}
   std::vector <BasicBlock*>& getSuccessors () {return successors;}
   const std::vector<Instruction*>& getInstructions() {return cmds;}
+  void setInstructions (const std::vector<Instruction*>& _cmds) {cmds = _cmds;}
   
-  virtual LLSPLAction* convertToLLSPL (std::vector<LLSPLSequence*>& basicBlockCollection)
-  {
-    std::vector<LLSPLAction*> actions;
-    if (converted) {
-      return (LLSPLSequence*)seq;
-    }
-     
-    converted = true;
-    
-    seq = new LLSPLSequence (getActionName ());
-    basicBlockCollection.push_back ((LLSPLSequence*)seq);
-    
-    for (auto cmd : cmds) {
-      LLSPLAction* act;
-      act = cmd->convertToLLSPL (basicBlockCollection);
-      if (act != nullptr) {
-        seq->appendAction (act);
-      }
-    }
-    
-    
-    return seq;
-  }
+  void addDeadValue (Instruction* instr, VersionedSymbol value) {deadValues[instr].push_back (value);}
+  const std::vector<VersionedSymbol>& getDeadValues (Instruction* instr);
+  //Projection code deleting values from the saved state, "" for none.
+  static std::string getDeleteCode (const std::vector<VersionedSymbol>& values);
+  //Projection code setting the PHIs of this block to the values flowing in
+  //from pred, "" for none.
+  std::string getPHICopyCode (BasicBlock* pred);
   
-  virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection)
-  {
-    std::vector<WhiskAction*> actions;
-    if (converted) {
-      return (WhiskSequence*)seq;
-    }
-     
-    converted = true;
-    
-    seq = new WhiskSequence (getActionName ());
-    basicBlockCollection.push_back ((WhiskSequence*)seq);
-    
-    for (auto cmd : cmds) {
-      WhiskAction* act;
-      act = cmd->convert (program, basicBlockCollection);
-      seq->appendAction (act);
-    }
-    
-    
-    return seq;
-  }
+  virtual LLSPLAction* convertToLLSPL (std::vector<LLSPLSequence*>& basicBlockCollection);
+  virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection);
   
+  //The Whisk backend names basic blocks after the program, see WhiskProgram.
   virtual std::string getActionName ()
   {
-    return actionName;
+    return "Sequence_" + gen_hash_str (basicBlockName, WHISK_SEQ_NAME_LENGTH);
   }
   
   const std::string getBasicBlockName () const {return basicBlockName;}
@@ -297,8 +327,10 @@ public:
 class Program : public IRNode
 {
 public:
-  typedef std::unordered_map <std::string, std::string> JSONKeyAnalysis;
-  typedef std::unordered_map <std::string, std::unordered_map <BasicBlock*, Instruction*>> LivenessAnalysis;
+  typedef std::unordered_map <VersionedSymbol, std::string> JSONKeyAnalysis;
+  //For every saved value and BasicBlock, the Instruction after which the
+  //value is dead in that block, nullptr if it is dead on entry to it.
+  typedef std::unordered_map <VersionedSymbol, std::unordered_map <BasicBlock*, Instruction*>> LivenessAnalysis;
   
 private:
   std::vector <BasicBlock*> basicBlocks;
@@ -306,12 +338,14 @@ private:
   LivenessAnalysis livenessAnalysis;
   
 public:
-  Program (std::vector <BasicBlock*> _basicBlocks) : basicBlocks(_basicBlocks)
+  Program (std::vector <BasicBlock*> _basicBlocks) : IRNode (ProgramKind), basicBlocks(_basicBlocks)
   {}
   
-  Program ()
+  Program () : IRNode (ProgramKind)
   {}
   
+  static bool classof (const IRNode* node) {return node->getKind () == ProgramKind;}
+  
   LivenessAnalysis& getLivenessAnalysis () {return livenessAnalysis;}
   JSONKeyAnalysis& getJSONKeyAnalysis () {return jsonKeyAnalysis;}
   
@@ -323,6 +357,11 @@ public:
   void setLivenessAnalysis (LivenessAnalysis _liveness)
   {
     livenessAnalysis = _liveness;
+    for (auto& valueToBlocks : livenessAnalysis) {
+      for (auto& blockToInstr : valueToBlocks.second) {
+        blockToInstr.first->addDeadValue (blockToInstr.second, valueToBlocks.first);
+      }
+    }
   }
   
   
@@ -340,16 +379,15 @@ public:
   {
     basicBlocks[0]->convertToLLSPL (basicBlockCollection);
     
-    return new LLSPLProgram ("Program_"+gen_random_str(WHISK_SEQ_NAME_LENGTH), 
-                             basicBlockCollection);
+    return arenaNew<LLSPLProgram> ("Program_"+gen_hash_str(basicBlocks[0]->getActionName (), WHISK_SEQ_NAME_LENGTH), 
+                                   basicBlockCollection);
   }
   
   virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection)
   {
     basicBlocks[0]->convert (program, basicBlockCollection);
     
-    return new WhiskProgram ("Program_"+gen_random_str(WHISK_SEQ_NAME_LENGTH), 
-                             basicBlockCollection);
+    return arenaNew<WhiskProgram> (basicBlockCollection);
   }
   
   virtual void print (std::ostream& os)
@@ -370,48 +408,43 @@ class Call : public Instruction
 protected:
   Identifier* retVal;
   ActionName actionName;
-  Identifier* arg;
-  std::string forkName;
-  std::string projName;
+  //Computed in the projection before the fork.
+  Expression* arg;
   
 public:
-  Call (Identifier* _retVal, ActionName _actionName, Identifier* _arg) : 
-    Instruction(), retVal(_retVal), actionName (_actionName), arg(_arg) 
+  Call (Identifier* _retVal, ActionName _actionName, Expression* _arg) : 
+    Instruction(CallKind), retVal(_retVal), actionName (_actionName), arg(_arg)
   {
     retVal->setCallStmt(this);
-    forkName = "Fork_" + actionName + "_" + gen_random_str(WHISK_FORK_NAME_LENGTH);
-    projName = "Proj_" + actionName + "_" + gen_random_str(WHISK_FORK_NAME_LENGTH);
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == CallKind;}
+  
   Identifier* getReturnValue() {return retVal;}
   virtual std::string getActionName() {return actionName;}
-  Identifier* getArgument() {return arg;}
+  Expression* getArgument() {return arg;}
   void setReturnValue (Identifier* ret) {retVal = ret;}
-  void setArgument (Identifier* _arg) {arg = _arg;}
+  void setArgument (Expression* _arg) {arg = _arg;}
   
+  //Name of the fork of this action, see ServerlessFork.
   virtual std::string getForkName() 
   {
-    return forkName;
+    return "Fork_" + actionName + "_" + gen_hash_str (actionName, WHISK_FORK_NAME_LENGTH);
   }
   
   virtual LLSPLAction* convertToLLSPL (std::vector<LLSPLSequence*>& basicBlockCollection)
   {
-    return new LLSPLProjForkPair (new LLSPLProjection (projName, R"(. * {\"input\": )"+arg->convert()+"}"),
-                                  new LLSPLFork (getForkName (), getActionName (), 
-                                  retVal->getIDWithVersion()));
+    return arenaNew<LLSPLProjForkPair> (arenaNew<LLSPLProjection> (jqAssignment (".input", arg->convert ())),
+                                        arenaNew<LLSPLFork> (getActionName (), 
+                                        retVal->getIDWithVersion()));
   }
   
   virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection)
   {
-    return new WhiskProjForkPair (new WhiskProjection (projName, R"(. * {\"input\": )"+arg->convert()+"}"),
-                                  new WhiskFork (getForkName (), getActionName (), 
-                                                 retVal->getIDWithVersion(), 
-                                                 program->getJSONKeyAnalysis ()[retVal->getIDWithVersion()]));
-  }
-  
-  std::string getProjName ()
-  {
-    return projName;
+    return arenaNew<WhiskProjForkPair> (arenaNew<WhiskProjection> (jqAssignment (".input", arg->convert ())),
+                                        arenaNew<WhiskFork> (getActionName (), 
+                                                             retVal->getIDWithVersion(), 
+                                                             program->getJSONKeyAnalysis ()[retVal->getVersionedSymbol ()]));
   }
   
   virtual void print (std::ostream& os)
@@ -434,9 +467,13 @@ private:
   std::string name;
 
 public:
-  Pointer (std::string _name) : name(_name) {}
+  Pointer (std::string _name) : Expression (PointerKind), name(_name) {}
+  
+  static bool classof (const IRNode* node) {return node->getKind () == PointerKind;}
   
   std::string getName () {return name;}
+  //The key in .saved, pointers are not SSA values and keep their name.
+  std::string getKey () {return name;}
   
   virtual std::string convertToLLSPL () 
   {
@@ -445,7 +482,7 @@ public:
   
   virtual std::string convert () 
   {
-    return ".saved."+name;
+    return ".saved."+getKey ();
   }
   
   virtual void print (std::ostream& os)
@@ -464,28 +501,26 @@ class LoadPointer : public Instruction
 private:
   Identifier* retVal;
   Pointer* ptr;
-  std::string projName;
   
 public:
-  LoadPointer (Identifier* _retVal, Pointer* _ptr) : retVal(_retVal), ptr(_ptr)
+  LoadPointer (Identifier* _retVal, Pointer* _ptr) : 
+    Instruction (LoadPointerKind), retVal(_retVal), ptr(_ptr)
   {
-    projName = "Proj_Load_" + gen_random_str(WHISK_FORK_NAME_LENGTH);
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == LoadPointerKind;}
+  
   Identifier* getRetVal () {return retVal;}
+  Pointer* getPointer () {return ptr;}
   
   virtual LLSPLAction* convertToLLSPL (std::vector<LLSPLSequence*>& basicBlockCollection)
   {
-    std::string retValID = retVal->getID ()+"_"+std::to_string (retVal->getVersion ());
-    return new LLSPLProjection (projName,
-                                R"(. * {\"saved\":{\")"+retValID+ R"(\":)"+ptr->convert () + "}}");
+    return arenaNew<LLSPLProjection> (jqAssignment (".saved." + retVal->getIDWithVersion (), ptr->convert ()));
   }
   
   virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection)
   {
-     std::string retValID = retVal->getID ()+"_"+std::to_string (retVal->getVersion ());
-     return new WhiskProjection (projName,
-                                 R"(. * {\"saved\":{\")"+retValID+ R"(\":)"+ptr->convert () + "}}");
+     return arenaNew<WhiskProjection> (jqAssignment (".saved." + retVal->getIDWithVersion (), ptr->convert ()));
   }
   
   virtual void print (std::ostream& os)
@@ -503,10 +538,7 @@ public:
     abort ();
   }
   
-  virtual std::string getActionName () 
-  {
-    return projName;
-  }
+  virtual std::string getActionName () {return "Load_ptr";}
   
   virtual void accept(IRNodeVisitor* visitor, IRNodeVisitorArg arg)
   {
@@ -519,30 +551,33 @@ class StorePointer : public Instruction
 private:
   Expression* expr;
   Pointer* ptr;
-  std::string projName;
   
 public:
-  StorePointer (Expression* _expr, Pointer* _ptr) : expr(_expr), ptr(_ptr) 
+  StorePointer (Expression* _expr, Pointer* _ptr) : 
+    Instruction (StorePointerKind), expr(_expr), ptr(_ptr) 
   {
-    projName = "Proj_StorePtr_"+gen_random_str(WHISK_PROJ_NAME_LENGTH);
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == StorePointerKind;}
+  
+  Pointer* getPointer () {return ptr;}
+  
   virtual LLSPLAction* convertToLLSPL (std::vector<LLSPLSequence*>& basicBlockCollection)
   {
     std::string code;
     
-    code = R"(. * { \"saved\" : {\" )" + ptr->getName () + R"(\":)" + expr->convert () + "}}";
+    code = jqAssignment (".saved." + ptr->getKey (), expr->convert ());
     
-    return new LLSPLProjection (projName, code);
+    return arenaNew<LLSPLProjection> (code);
   }
   
   virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection)
   {
     std::string code;
     
-    code = R"(. * { \"saved\" : {\" )" + ptr->getName () + R"(\":)" + expr->convert () + "}}";
+    code = jqAssignment (".saved." + ptr->getKey (), expr->convert ());
     
-    return new WhiskProjection (projName, code);
+    return arenaNew<WhiskProjection> (code);
   }
   
   virtual void print (std::ostream& os)
@@ -570,26 +605,26 @@ public:
 class Return : public Instruction
 {
 private:
-  Identifier* exp;
-  std::string name;
+  Expression* exp;
   
 public:
-  Return (Identifier* _exp) : Instruction ()
+  Return (Expression* _exp) : Instruction (ReturnKind)
   {
     exp = _exp;
-    name = "Proj_" + gen_random_str (WHISK_PROJ_NAME_LENGTH);
   }
   
-  Identifier* getReturnExpr() {return exp;}
+  static bool classof (const IRNode* node) {return node->getKind () == ReturnKind;}
+  
+  Expression* getReturnExpr() {return exp;}
   
   virtual LLSPLAction* convertToLLSPL (std::vector<LLSPLSequence*>& basicBlockCollection)
   {
-    return new LLSPLProjection (name, getReturnExpr ()->convert ());
+    return arenaNew<LLSPLProjection> (getReturnExpr ()->convert ());
   }
   
   virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection)
   {
-    return new WhiskProjection (name, getReturnExpr ()->convert ());
+    return arenaNew<WhiskProjection> (getReturnExpr ()->convert ());
   }
   
   virtual void accept(IRNodeVisitor* visitor, IRNodeVisitorArg arg)
@@ -604,10 +639,7 @@ public:
     os << std::endl;
   }
   
-  virtual std::string getActionName ()
-  {
-    return name;
-  }
+  virtual std::string getActionName () {return "Return";}
 };
 
 class Transformation : public Instruction
@@ -616,15 +648,15 @@ private:
   Identifier* out;
   Identifier* in;
   Expression* transformation;
-  std::string name;
   
 public:
   Transformation (Identifier* _out, Identifier* _in, Expression* _trans) : 
-    Instruction(), out(_out), in(_in), transformation(_trans) 
+    Instruction(TransformationKind), out(_out), in(_in), transformation(_trans) 
   {
-    name = "Proj_"+gen_random_str(WHISK_PROJ_NAME_LENGTH);
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == TransformationKind;}
+  
   const Identifier* getOutput() {return out;}
   const Identifier* getInput() {return in;}
   const Expression* getTransformation() {return transformation;}
@@ -635,7 +667,7 @@ public:
     
     code = transformation->convert ();
     
-    return new LLSPLProjection (name, code);
+    return arenaNew<LLSPLProjection> (code);
   }
   
   virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection)
@@ -644,13 +676,10 @@ public:
     
     code = transformation->convert ();
     
-    return new WhiskProjection (name, code);
+    return arenaNew<WhiskProjection> (code);
   }
   
-  virtual std::string getActionName ()
-  {
-    return name;
-  }
+  virtual std::string getActionName () {return "Transformation";}
   
   virtual void print (std::ostream& os)
   {
@@ -673,15 +702,15 @@ class Assignment : public Instruction
 private:
   Identifier* out;
   Expression* in;
-  std::string name;
   
 public:
   Assignment (Identifier* _out, Expression* _in) : 
-    Instruction(), out(_out), in(_in)
+    Instruction(AssignmentKind), out(_out), in(_in)
   {
-    name = "Proj_"+gen_random_str(WHISK_PROJ_NAME_LENGTH);
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == AssignmentKind;}
+  
   Identifier* getOutput() const {return out;}
   Expression* getInput() const {return in;}
   
@@ -689,22 +718,19 @@ public:
   {
     std::string code;
     
-    code = R"(. * {\"saved\": {\")" + out->getIDWithVersion () + R"(\":)" + in->convert () + "}}";
-    return new LLSPLProjection (name, code);
+    code = jqAssignment (".saved." + out->getIDWithVersion (), in->convert ());
+    return arenaNew<LLSPLProjection> (code);
   }
   
   virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection)
   {
     std::string code;
     
-    code = R"(. * {\"saved\": {\")" + out->getIDWithVersion () + R"(\":)" + in->convert () + "}}";
-    return new WhiskProjection (name, code);
+    code = jqAssignment (".saved." + out->getIDWithVersion (), in->convert ());
+    return arenaNew<WhiskProjection> (code);
   }
   
-  virtual std::string getActionName ()
-  {
-    return name;
-  }
+  virtual std::string getActionName () {return "Assignment";}
   
   virtual void print (std::ostream& os)
   {
@@ -728,8 +754,11 @@ private:
   Identifier* id;
 
 public:
-  Let (Identifier* _id, Expression* _expr) : id(_id), expr(_expr) 
+  Let (Identifier* _id, Expression* _expr) : Instruction (LetKind), expr(_expr), id(_id) 
   {}
+  
+  static bool classof (const IRNode* node) {return node->getKind () == LetKind;}
+  
   virtual LLSPLAction* convertToLLSPL (std::vector<LLSPLSequence*>& basicBlockCollection)
   {
     abort ();
@@ -757,9 +786,11 @@ private:
   
 public:
   Conditional (Expression* _op1, ConditionalOperator _op, Expression* _op2) :
-    op (_op), op1(_op1), op2(_op2)
+    Expression (ConditionalKind), op (_op), op1(_op1), op2(_op2)
   {}
   
+  static bool classof (const IRNode* node) {return node->getKind () == ConditionalKind;}
+  
   Expression* getOp1 () {return op1;}
   Expression* getOp2 () {return op2;}
   ConditionalOperator getOperator () {return op;}
@@ -795,12 +826,12 @@ private:
   Conditional* expr;
   BasicBlock* thenBranch;
   BasicBlock* elseBranch;
-  std::string seqName;
   BasicBlock* parent;
   
 public:
   ConditionalBranch (Conditional* _expr, BasicBlock* _thenBranch, 
-                     BasicBlock* _elseBranch, BasicBlock* _parent)
+                     BasicBlock* _elseBranch, BasicBlock* _parent) : 
+    Instruction (ConditionalBranchKind)
   {
     expr = _expr;
     thenBranch = _thenBranch;
@@ -810,25 +841,26 @@ public:
     elseBranch->appendPredecessor (parent);
     parent->appendSuccessor (thenBranch);
     parent->appendSuccessor (elseBranch);
-    seqName = "Seq_IF_THEN_ELSE_"+gen_random_str (WHISK_SEQ_NAME_LENGTH);
   }
   
   ConditionalBranch (Conditional* _expr, Instruction* _thenBranch, 
-                     Instruction* _elseBranch, BasicBlock* _parent)
+                     Instruction* _elseBranch, BasicBlock* _parent) : 
+    Instruction (ConditionalBranchKind)
   {
     expr = _expr;
     parent = _parent;
-    thenBranch = new BasicBlock ();
+    thenBranch = arenaNew<BasicBlock> ();
     thenBranch->appendInstruction (_thenBranch);
     thenBranch->appendPredecessor (_parent);
-    elseBranch = new BasicBlock ();
+    elseBranch = arenaNew<BasicBlock> ();
     elseBranch->appendInstruction (_elseBranch);
     elseBranch->appendPredecessor (_parent);
     parent->appendSuccessor (thenBranch);
     parent->appendSuccessor (elseBranch);
-    seqName = "Seq_IF_THEN_ELSE_"+gen_random_str (WHISK_SEQ_NAME_LENGTH);
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == ConditionalBranchKind;}
+  
   BasicBlock* getThenBranch () 
   {
     return thenBranch;
@@ -849,6 +881,11 @@ public:
     elseBranch = _elseBranch;
   }
   
+  void setParent (BasicBlock* _parent)
+  {
+    parent = _parent;
+  }
+  
   Conditional* getCondition ()
   {
     return expr;
@@ -864,31 +901,27 @@ public:
     thenAction = thenBranch->convertToLLSPL (basicBlockCollection);
     elseAction = elseBranch->convertToLLSPL (basicBlockCollection);
     
-    return new LLSPLIf ("If_" + gen_random_str (WHISK_PROJ_NAME_LENGTH), cond, thenAction, elseAction);
+    return arenaNew<LLSPLIf> ("If_" + gen_hash_str (cond + thenAction->getName () + elseAction->getName (), WHISK_PROJ_NAME_LENGTH),
+                              cond, thenAction, elseAction);
   }
   
   virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection)
   {
-    WhiskAction* proj;
-    WhiskSequence* thenSeq;
-    WhiskSequence* elseSeq;
+    WhiskAction* thenSeq;
+    WhiskAction* elseSeq;
     WhiskSequence* toReturn;
-    std::string code;
     
-    code = expr->convert ();
-    thenSeq = dynamic_cast <WhiskSequence*> (thenBranch->convert(program, basicBlockCollection));
-    elseSeq = dynamic_cast <WhiskSequence*> (elseBranch->convert(program, basicBlockCollection));
-    code = "if ("+code+R"() then (. * {\"action\": \")" + thenSeq->getName () + 
-      R"(\"}) else (. * {\"action\":\")" + elseSeq->getName () + R"(\"}))";
-    proj = new WhiskProjection ("Proj_"+gen_random_str (WHISK_PROJ_NAME_LENGTH),
-                                code);
-    toReturn = new WhiskSequence (seqName);
-    toReturn->appendAction (proj);
+    thenSeq = thenBranch->convert(program, basicBlockCollection);
+    elseSeq = elseBranch->convert(program, basicBlockCollection);
+    toReturn = arenaNew<WhiskSequence> ();
+    toReturn->appendAction (arenaNew<WhiskBranchProjection> (expr->convert (), thenSeq, elseSeq,
+                                                             thenBranch->getPHICopyCode (parent),
+                                                             elseBranch->getPHICopyCode (parent)));
     
     return toReturn;
   }
   
-  virtual std::string getActionName () {return seqName;}
+  virtual std::string getActionName () {return "If";}
   
   virtual void print (std::ostream& os)
   {
@@ -910,47 +943,73 @@ class PHI : public Instruction
 {
 private:
   std::vector<std::pair<BasicBlock*, Identifier*> > commandExprVector;
-  std::string projName;
   Identifier* output;
   
 public:
   PHI (Identifier* _output, 
        std::vector<std::pair<BasicBlock*, Identifier*> > _commandExprVector) :
-    commandExprVector (_commandExprVector), output (_output)
+    Instruction (PHIKind), commandExprVector (_commandExprVector), output (_output)
   {
-    projName = "Proj_"+gen_random_str(WHISK_PROJ_NAME_LENGTH);
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == PHIKind;}
+  
   const std::vector<std::pair<BasicBlock*, Identifier*> >& getCommandExprVector ()
   {
     return commandExprVector;
   }
-  
-  Identifier* getOutput () {return output;}
-  
-  virtual LLSPLAction* convertToLLSPL(std::vector<LLSPLSequence*>& basicBlockCollection)
+
+  //Sets the value flowing in from pred, which must already have an entry.
+  void setIncoming (BasicBlock* pred, Identifier* value)
   {
-    std::string _finalString;
-    int i;
-    
-    for (i = 0; i < commandExprVector.size () - 1; i++) {
-      _finalString += "if ( . ^ "+ commandExprVector[i].second->convert().substr(1) +
-        " == true) then " + commandExprVector[i].second->convert();
-      _finalString += " else ( ";
+    for (auto& blockIdPair : commandExprVector) {
+      if (blockIdPair.first == pred) {
+        blockIdPair.second = value;
+        return;
+      }
     }
-    
-    _finalString += commandExprVector[i].second->convert();
-    
-    for (i = 1; i < commandExprVector.size (); i++) {
-      _finalString += ")";
+
+    abort ();
+  }
+
+  void addIncoming (BasicBlock* pred, Identifier* value)
+  {
+    commandExprVector.push_back (std::make_pair (pred, value));
+  }
+
+  //Returns the value flowing in from pred, which must have an entry.
+  Identifier* getIncoming (BasicBlock* pred)
+  {
+    for (auto& blockIdPair : commandExprVector) {
+      if (blockIdPair.first == pred)
+        return blockIdPair.second;
+    }
+
+    abort ();
+  }
+
+  //The value flowing in from pred now flows in from newPred.
+  void replaceIncomingBlock (BasicBlock* pred, BasicBlock* newPred)
+  {
+    for (auto& blockIdPair : commandExprVector) {
+      if (blockIdPair.first == pred)
+        blockIdPair.first = newPred;
+    }
+  }
+
+  void removeIncoming (BasicBlock* pred)
+  {
+    for (auto iter = commandExprVector.begin (); iter != commandExprVector.end (); iter++) {
+      if (iter->first == pred) {
+        commandExprVector.erase (iter);
+        return;
+      }
     }
-    
-    _finalString = R"(. * {\"saved\":{\")" + output->getIDWithVersion () + R"(\":)" + _finalString + "}}";
-    
-    return new LLSPLProjection (projName, _finalString);
   }
+
+  Identifier* getOutput () {return output;}
   
-  virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection) 
+  virtual LLSPLAction* convertToLLSPL(std::vector<LLSPLSequence*>& basicBlockCollection)
   {
     std::string _finalString;
     int i;
@@ -967,16 +1026,21 @@ public:
       _finalString += ")";
     }
     
-    _finalString = R"(. * {\"saved\":{\")" + output->getIDWithVersion () + R"(\":)" + _finalString + "}}";
+    _finalString = jqAssignment (".saved." + output->getIDWithVersion (), _finalString);
     
-    return new WhiskProjection (projName, _finalString);
+    return arenaNew<LLSPLProjection> (_finalString);
   }
   
-  virtual std::string getActionName ()
+  //The predecessors set the PHIs of a block on their branch to it, see
+  //BasicBlock::getPHICopyCode.
+  virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection) 
   {
-    return projName;
+    fprintf (stderr, "PHI::convert should not be called\n");
+    abort ();
   }
   
+  virtual std::string getActionName () {return "PHI";}
+  
   virtual void print (std::ostream& os)
   {
     output->print (os);
@@ -1005,23 +1069,34 @@ protected:
   BasicBlock* parent;
   
 public:
-  DirectBranch (BasicBlock* _target, BasicBlock *_parent) : target(_target), parent(_parent)
+  DirectBranch (BasicBlock* _target, BasicBlock *_parent) : 
+    DirectBranch (_target, _parent, DirectBranchKind) {}
+  
+protected:
+  DirectBranch (BasicBlock* _target, BasicBlock *_parent, NodeKind _kind) : 
+    Instruction (_kind), target(_target), parent(_parent)
   {
     target->appendPredecessor (parent);
     parent->appendSuccessor (target);
   }
   
+public:
+  static bool classof (const IRNode* node)
+  {
+    return node->getKind () == DirectBranchKind || node->getKind () == BackwardBranchKind;
+  }
+  
   virtual LLSPLAction* convertToLLSPL(std::vector<LLSPLSequence*>& basicBlockCollection)
   {
     target->convertToLLSPL (basicBlockCollection);
     return nullptr;
-    return new LLSPLDirectBranch (target->getActionName ());
+    return arenaNew<LLSPLDirectBranch> (target->getActionName ());
   }
   
   virtual WhiskAction* convert (Program* program, std::vector<WhiskSequence*>& basicBlockCollection)
   {
-    target->convert (program, basicBlockCollection);
-    return new WhiskDirectBranch (target->getActionName ());
+    return arenaNew<WhiskDirectBranch> (target->convert (program, basicBlockCollection),
+                                        target->getPHICopyCode (parent));
   }
   
   virtual std::string getActionName ()
@@ -1031,6 +1106,8 @@ public:
   }
   
   BasicBlock* getTarget () {return target;}
+  void setTarget (BasicBlock* _target) {target = _target;}
+  void setParent (BasicBlock* _parent) {parent = _parent;}
   
   virtual void print (std::ostream& os) 
   {
@@ -1047,7 +1124,10 @@ public:
 class BackwardBranch : public DirectBranch
 {
 public:
-  BackwardBranch (BasicBlock* _target, BasicBlock *_parent) : DirectBranch (_target, _parent) {}
+  BackwardBranch (BasicBlock* _target, BasicBlock *_parent) : 
+    DirectBranch (_target, _parent, BackwardBranchKind) {}
+  
+  static bool classof (const IRNode* node) {return node->getKind () == BackwardBranchKind;}
   
   virtual void print (std::ostream& os) 
   {
@@ -1063,6 +1143,14 @@ public:
 
 class Constant : public Expression
 {
+protected:
+  Constant (NodeKind _kind) : Expression (_kind) {}
+  
+public:
+  static bool classof (const IRNode* node)
+  {
+    return node->getKind () >= FirstConstantKind && node->getKind () <= LastConstantKind;
+  }
 };
 
 class Number : public Constant
@@ -1071,10 +1159,13 @@ private:
   float number;
   
 public:
-  Number (float _number) : number(_number)
+  Number (float _number) : Constant (NumberKind), number(_number)
   {
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == NumberKind;}
+  float getNumber () {return number;}
+  
   virtual std::string convertToLLSPL () 
   {
     return convert ();
@@ -1102,10 +1193,13 @@ private:
   std::string str;
   
 public:
-  String (std::string _str) : str(_str) 
+  String (std::string _str) : Constant (StringKind), str(_str) 
   {
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == StringKind;}
+  const std::string& getString () {return str;}
+  
   virtual std::string convert ()
   {
     return str;
@@ -1133,10 +1227,13 @@ private:
   bool boolean;
   
 public:
-  Boolean (bool _boolean) : boolean(_boolean) 
+  Boolean (bool _boolean) : Constant (BooleanKind), boolean(_boolean) 
   {
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == BooleanKind;}
+  bool getBoolean () {return boolean;}
+  
   virtual std::string convertToLLSPL () 
   {
     return convert ();
@@ -1172,10 +1269,12 @@ private:
   std::vector<Expression*> exprs;
   
 public:
-  Array (std::vector<Expression*> _exprs): exprs(_exprs) 
+  Array (std::vector<Expression*> _exprs): Expression (ArrayKind), exprs(_exprs) 
   {
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == ArrayKind;}
+  
   virtual std::string convertToLLSPL () 
   {
     return convert ();
@@ -1209,10 +1308,13 @@ private:
   Expression* value;
   
 public:
-  JSONKeyValuePair (std::string _key, Expression* _value) : key(_key), value(_value)
+  JSONKeyValuePair (std::string _key, Expression* _value) : 
+    IRNode (JSONKeyValuePairKind), key(_key), value(_value)
   {
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == JSONKeyValuePairKind;}
+  
   std::string getKey () {return key;}
   Expression* getValue () {return value;}
   
@@ -1244,10 +1346,12 @@ private:
   std::vector<JSONKeyValuePair*> kvpairs;
   
 public:
-  JSONObject (std::vector<JSONKeyValuePair*> _kvpairs) : kvpairs(_kvpairs) 
+  JSONObject (std::vector<JSONKeyValuePair*> _kvpairs) : Expression (JSONObjectKind), kvpairs(_kvpairs) 
   {
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == JSONObjectKind;}
+  
   std::vector<JSONKeyValuePair*>& getKeyValuePairs ()
   {
     return kvpairs;
@@ -1296,7 +1400,9 @@ public:
 class Input : public Identifier 
 {
 public:
-  Input () : Identifier ("input", 0) {}
+  Input () : Identifier (SymbolTable::intern ("input"), 0, nullptr, InputKind) {}
+  
+  static bool classof (const IRNode* node) {return node->getKind () == InputKind;}
   
   virtual std::string convertToLLSPL () 
   {
@@ -1316,7 +1422,15 @@ public:
 
 class Pattern : public IRNode
 {
+protected:
+  Pattern (NodeKind _kind) : IRNode (_kind) {}
+  
 public:
+  static bool classof (const IRNode* node)
+  {
+    return node->getKind () >= FirstPatternKind && node->getKind () <= LastPatternKind;
+  }
+  
   virtual std::string convert () = 0;
 };
 
@@ -1327,10 +1441,13 @@ private:
   Pattern* pat;
   
 public:
-  PatternApplication (Expression* _expr, Pattern* _pat): expr(_expr), pat(_pat)
+  PatternApplication (Expression* _expr, Pattern* _pat): 
+    Expression (PatternApplicationKind), expr(_expr), pat(_pat)
   {
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == PatternApplicationKind;}
+  
   Pattern* getPattern () {return pat;}
   
   Expression* getIdentifier () {return expr;}
@@ -1364,7 +1481,7 @@ public:
     std::vector<Pattern*> allPatterns;
     Expression* patApp = this;
 
-    while (dynamic_cast <PatternApplication*> (patApp) != nullptr) {
+    while (isa <PatternApplication> (patApp)) {
       Pattern* pat = ((PatternApplication*)patApp)->getPattern ();
       
       allPatterns.insert (allPatterns.begin(), ((PatternApplication*)patApp)->getPattern ()); //Insert in reverse order
@@ -1381,10 +1498,12 @@ private:
   std::string fieldName;
   
 public:
-  FieldGetPattern (std::string _fieldName) : fieldName(_fieldName) 
+  FieldGetPattern (std::string _fieldName) : Pattern (FieldGetPatternKind), fieldName(_fieldName) 
   {
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == FieldGetPatternKind;}
+  
   virtual std::string convertToLLSPL () 
   {
     return convert ();
@@ -1414,10 +1533,14 @@ private:
   int index;
   
 public:
-  ArrayIndexPattern (int _index) : index(_index) 
+  ArrayIndexPattern (int _index) : Pattern (ArrayIndexPatternKind), index(_index) 
   {
   }
   
+  int getIndex () {return index;}
+  
+  static bool classof (const IRNode* node) {return node->getKind () == ArrayIndexPatternKind;}
+  
   virtual std::string convertToLLSPL () 
   {
     return convert ();
@@ -1445,10 +1568,12 @@ private:
   std::string keyName;
   
 public:
-  KeyGetPattern (std::string _keyName) : keyName(_keyName) 
+  KeyGetPattern (std::string _keyName) : Pattern (KeyGetPatternKind), keyName(_keyName) 
   {
   }
   
+  static bool classof (const IRNode* node) {return node->getKind () == KeyGetPatternKind;}
+  
   virtual std::string convertToLLSPL () 
   {
     return convert ();
@@ -1478,8 +1603,10 @@ private:
   std::vector <Pattern*> pats;
 
 public:
-  Patterns () {}
-  Patterns (std::vector<Pattern*>& _pats) : pats (_pats) {}
+  Patterns () : Pattern (PatternsKind) {}
+  Patterns (std::vector<Pattern*>& _pats) : Pattern (PatternsKind), pats (_pats) {}
+  
+  static bool classof (const IRNode* node) {return node->getKind () == PatternsKind;}
   
   virtual std::string convertToLLSPL () 
   {
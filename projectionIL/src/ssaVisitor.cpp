@@ -332,10 +332,10 @@ void UseDefVisitor::visit (Assignment* assign, IRNodeVisitorArg arg)
   std::vector<Identifier*> ids = idsVisitor.getAllInputIds(assign->getInput ());
   
   for (auto id : ids) {
-    argToUseDef (arg)->addUse (id->getIDWithVersion (), assign);
+    argToUseDef (arg)->addUse (id->getVersionedSymbol (), assign);
   }
   
-  argToUseDef (arg)->setDef (assign->getOutput ()->getIDWithVersion (), assign);
+  argToUseDef (arg)->setDef (assign->getOutput ()->getVersionedSymbol (), assign);
 }
 
 void UseDefVisitor::visit (BackwardBranch* backBr, IRNodeVisitorArg arg)
@@ -360,10 +360,10 @@ void UseDefVisitor::visit (Call* call, IRNodeVisitorArg arg)
   std::vector<Identifier*> ids = idsVisitor.getAllInputIds(call->getArgument ());
   
   for (auto id : ids) {
-    argToUseDef (arg)->addUse (id->getIDWithVersion (), call);
+    argToUseDef (arg)->addUse (id->getVersionedSymbol (), call);
   }
   
-  argToUseDef (arg)->setDef (call->getReturnValue ()->getIDWithVersion (), call);
+  argToUseDef (arg)->setDef (call->getReturnValue ()->getVersionedSymbol (), call);
 }
 
 void UseDefVisitor::visit (Conditional* cond, IRNodeVisitorArg arg)
@@ -377,7 +377,7 @@ void UseDefVisitor::visit (ConditionalBranch* condBr, IRNodeVisitorArg arg)
   std::vector<Identifier*> ids = idsVisitor.getAllInputIds(condBr->getCondition ());
   
   for (auto id : ids) {
-    argToUseDef (arg)->addUse (id->getIDWithVersion (), condBr);
+    argToUseDef (arg)->addUse (id->getVersionedSymbol (), condBr);
   }
 }
 
@@ -419,7 +419,7 @@ void UseDefVisitor::visit (Let* let, IRNodeVisitorArg arg)
 
 void UseDefVisitor::visit (LoadPointer* ldPtr, IRNodeVisitorArg arg)
 {
-  argToUseDef (arg)->setDef (ldPtr->getRetVal ()->getIDWithVersion (), ldPtr);
+  argToUseDef (arg)->setDef (ldPtr->getRetVal ()->getVersionedSymbol (), ldPtr);
 }
 
 void UseDefVisitor::visit (Number* num, IRNodeVisitorArg arg)
@@ -433,11 +433,11 @@ void UseDefVisitor::visit (PHI* phi, IRNodeVisitorArg arg)
   
     std::vector<Identifier*> ids = idsVisitor.getAllInputIds (cmdExprPair.second);
     for (auto id : ids) {
-      argToUseDef (arg)->addUse (id->getIDWithVersion (), phi);
+      argToUseDef (arg)->addUse (id->getVersionedSymbol (), phi);
     }
   }
   
-  argToUseDef (arg)->setDef (phi->getOutput ()->getIDWithVersion (), phi);
+  argToUseDef (arg)->setDef (phi->getOutput ()->getVersionedSymbol (), phi);
 }
 
 void UseDefVisitor::visit (Pattern* pt, IRNodeVisitorArg arg)
@@ -469,13 +469,18 @@ void UseDefVisitor::visit (Return* ret, IRNodeVisitorArg arg)
   
   std::vector<Identifier*> ids = idsVisitor.getAllInputIds (ret->getReturnExpr ());
   for (auto id : ids) {
-    argToUseDef (arg)->addUse (id->getIDWithVersion (), ret);
+    argToUseDef (arg)->addUse (id->getVersionedSymbol (), ret);
   }
 }
 
 void UseDefVisitor::visit (StorePointer* strPtr, IRNodeVisitorArg arg)
 {
+  GetAllInputIdentifierVisitor idsVisitor;
   
+  std::vector<Identifier*> ids = idsVisitor.getAllInputIds (strPtr->getInputExpr ());
+  for (auto id : ids) {
+    argToUseDef (arg)->addUse (id->getVersionedSymbol (), strPtr);
+  }
 }
 
 void UseDefVisitor::visit (String* str, IRNodeVisitorArg arg) {}
@@ -484,7 +489,7 @@ void UseDef::printDefs ()
 {
   std::cout << "Defs: ---- " <<std::endl;
   for (auto iter : defMap) {
-    std::cout << iter.first << " " << iter.second << std::endl;
+    std::cout << SymbolTable::getName (symbolOf (iter.first)) << "_" << versionOf (iter.first) << " " << iter.second << std::endl;
   }
 }
 
@@ -492,7 +497,7 @@ void UseDef::printUses ()
 {
   std::cout << "Uses:-----" << std::endl;
   for (auto iter : useMap) {
-    std::cout << iter.first << ": ";
+    std::cout << SymbolTable::getName (symbolOf (iter.first)) << "_" << versionOf (iter.first) << ": ";
     for (auto iter2 : iter.second) {
       std::cout << iter2 << " ";
     }
@@ -122,8 +122,8 @@ public:
 class UseDef
 {
 public:
-  typedef std::unordered_map <std::string, std::unordered_set <Instruction*>> IdentifierToUseMap;
-  typedef std::unordered_map <std::string, Instruction*> IdentifierToDefMap;
+  typedef std::unordered_map <VersionedSymbol, std::unordered_set <Instruction*>> IdentifierToUseMap;
+  typedef std::unordered_map <VersionedSymbol, Instruction*> IdentifierToDefMap;
   
 private:
   IdentifierToUseMap useMap;
@@ -132,15 +132,16 @@ private:
 public:
   UseDef () {}
   
-  void setDef (std::string id, Instruction* def)
+  void setDef (VersionedSymbol id, Instruction* def)
   {
     assert (defMap.count (id) == 0);
     defMap [id] = def;
   }
   
-  void addUse (std::string id, Instruction* use)
+  //An instruction can read a value more than once, as an operand of both
+  //sides of a condition or from several predecessors in a PHI.
+  void addUse (VersionedSymbol id, Instruction* use)
   {
-    assert (useMap[id].count (use) == 0);
     useMap[id].insert (use);
   }
   
@@ -0,0 +1,102 @@
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+#ifndef __SYMBOLS_H__
+#define __SYMBOLS_H__
+
+/* Interned identifier names.
+ *
+ * Every name used by an SSA Identifier is mapped once to a dense Symbol,
+ * after which the compiler compares, hashes and indexes variables by that
+ * integer. A versioned SSA name (x_3) is a Symbol and a version packed into
+ * one 64 bit VersionedSymbol. The strings are only needed again when
+ * printing or generating code.
+ */
+
+typedef uint32_t Symbol;
+typedef uint64_t VersionedSymbol;
+
+class SymbolTable
+{
+private:
+  static std::unordered_map <std::string, Symbol> symbols;
+  //A deque so that references returned by getName stay valid while new
+  //names are interned.
+  static std::deque <std::string> names;
+  //Saved values sharing a key in .saved, see allocateSlots.
+  static std::unordered_map <VersionedSymbol, int> slots;
+
+public:
+  static Symbol intern (const std::string& name)
+  {
+    auto iter = symbols.find (name);
+
+    if (iter != symbols.end ())
+      return iter->second;
+
+    Symbol symbol = (Symbol) names.size ();
+    symbols[name] = symbol;
+    names.push_back (name);
+
+    return symbol;
+  }
+
+  static const std::string& getName (Symbol symbol) {return names[symbol];}
+  static size_t size () {return names.size ();}
+
+  static void setSlot (VersionedSymbol value, int slot) {slots[value] = slot;}
+  //Returns -1 for a value without a slot.
+  static int getSlot (VersionedSymbol value)
+  {
+    auto iter = slots.find (value);
+
+    return iter == slots.end () ? -1 : iter->second;
+  }
+  //The key of value in .saved, s<slot> or its name and version. Every
+  //other key has an underscore, so slots never clash with them.
+  static std::string getKey (VersionedSymbol value);
+  //The SSA name of value, x_3.
+  static std::string getVersionedName (VersionedSymbol value);
+
+  //Symbols belong to one compilation, like the Identifiers using them.
+  static void reset ()
+  {
+    symbols.clear ();
+    names.clear ();
+    slots.clear ();
+  }
+};
+
+inline VersionedSymbol makeVersionedSymbol (Symbol symbol, int version)
+{
+  return ((VersionedSymbol) symbol << 32) | (uint32_t) version;
+}
+
+inline Symbol symbolOf (VersionedSymbol versioned)
+{
+  return (Symbol) (versioned >> 32);
+}
+
+inline int versionOf (VersionedSymbol versioned)
+{
+  return (int) (uint32_t) versioned;
+}
+
+inline std::string SymbolTable::getKey (VersionedSymbol value)
+{
+  int slot = getSlot (value);
+
+  if (slot != -1)
+    return "s" + std::to_string (slot);
+
+  return getVersionedName (value);
+}
+
+inline std::string SymbolTable::getVersionedName (VersionedSymbol value)
+{
+  return getName (symbolOf (value)) + "_" + std::to_string (versionOf (value));
+}
+
+#endif /*__SYMBOLS_H__*/